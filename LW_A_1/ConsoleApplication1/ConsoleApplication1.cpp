@@ -4,6 +4,32 @@
 #include <random>
 #include <algorithm>
 #include <iomanip>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <barrier>
+#include <limits>
+#include <chrono>
+#include <cmath>
+#include <optional>
+#include <charconv>
+#include <cstdint>
+#include <type_traits>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <atomic>
+#include <coroutine>
+#include <utility>
+#include <memory>
+#include <cstddef>
+
+#include "../../common/ResultCache.h"
+#include "../../common/Profiler.h"
+#include "../../common/ColumnarFile.h"
+#ifdef LW_BENCHMARK
+#include "../../common/Benchmark.h"
+#endif
 
 
 // Генератор случайных чисел
@@ -14,8 +40,8 @@ private:
     std::uniform_int_distribution<int> difficulty_dist;
 
 public:
-    RandomGenerator(double a, double b)
-        : gen(std::random_device{}()),
+    RandomGenerator(double a, double b, unsigned seed = std::random_device{}())
+        : gen(seed),
         time_dist(a, b),
         difficulty_dist(1, 10) {
     }
@@ -27,15 +53,21 @@ public:
     int getDifficulty() {
         return difficulty_dist(gen);
     }
+
+    // Сменить интервал между клиентами, не трогая состояние генератора
+    void setTimeRange(double a, double b) {
+        time_dist = std::uniform_real_distribution<double>(a, b);
+    }
 };
 
 // Структура для клиента
 struct Client {
-    int id;
+    long long id; // Номер клиента: трассы бывают длиннее 2^31 строк
     double arrival_time;
     int difficulty;
+    int process = -1; // Процесс клиента в режиме процессов (номер в таблице процессов)
 
-    Client(int _id, double _time, int _diff)
+    Client(long long _id, double _time, int _diff)
         : id(_id), arrival_time(_time), difficulty(_diff) {
     }
 };
@@ -43,12 +75,12 @@ struct Client {
 // Структура для события
 struct Event {
     double time;
-    int type; // 0 - прибытие клиента, 1 - завершение обслуживания
-    int client_id;
+    long long client_id; // Перед type: событие остаётся в 24 байтах
+    int type; // 0 - прибытие клиента, 1 - завершение обслуживания, 2 - возобновление процесса (client_id - номер процесса)
     int agent_id;
 
-    Event(double t, int tp, int cid, int aid = -1)
-        : time(t), type(tp), client_id(cid), agent_id(aid) {
+    Event(double t, int tp, long long cid, int aid = -1)
+        : time(t), client_id(cid), type(tp), agent_id(aid) {
     }
 
     // Для приоритетной очереди (меньшее время - выше приоритет)
@@ -61,50 +93,94 @@ struct Event {
 class Agent {
 private:
     std::queue<Client> client_queue;
+    long long queued_difficulty; // Суммарная сложность клиентов в очереди
     double current_load; // Текущая загрузка
     double next_free_time; // Время, когда освободится
-    Client* current_client;
+    std::optional<Client> current_client; // Хранится по значению: без выделения памяти на клиента
 
 public:
     int id;
-    int served_count;
+    long long served_count;
     double total_work_time;
 
-    Agent(int _id) : id(_id), served_count(0), total_work_time(0.0),
-        current_load(0.0), next_free_time(0.0), current_client(nullptr) {
+    Agent(int _id) : queued_difficulty(0), current_load(0.0), next_free_time(0.0),
+        id(_id), served_count(0), total_work_time(0.0) {
+    }
+
+    // Состояние агента в снимке системы; клиенты очереди хранятся отдельно,
+    // в общем массиве снимка
+    struct State {
+        int id;
+        long long served_count;
+        double total_work_time;
+        double next_free_time;
+        std::optional<Client> current_client;
+        int queued; // Клиентов в очереди
+    };
+
+    State saveState(std::vector<Client>& queued) const {
+        std::queue<Client> rest = client_queue;
+        while (!rest.empty()) {
+            queued.push_back(rest.front());
+            rest.pop();
+        }
+        return State{ id, served_count, total_work_time, next_free_time, current_client,
+            static_cast<int>(client_queue.size()) };
+    }
+
+    // Восстановить агента из снимка: queued - первый клиент его очереди
+    Agent(const State& state, const Client* queued) : queued_difficulty(0), current_load(0.0),
+        next_free_time(state.next_free_time), current_client(state.current_client),
+        id(state.id), served_count(state.served_count), total_work_time(state.total_work_time) {
+        for (int i = 0; i < state.queued; i++) {
+            client_queue.push(queued[i]);
+            queued_difficulty += queued[i].difficulty;
+        }
+        updateLoad();
     }
 
     // Добавить клиента в очередь
     void addClient(const Client& client) {
         client_queue.push(client);
+        queued_difficulty += client.difficulty;
         updateLoad();
     }
 
     // Начать обслуживание следующего клиента
     bool startNextService(double current_time, std::priority_queue<Event, std::vector<Event>,
         std::greater<Event>>&events) {
-        if (client_queue.empty() || current_client != nullptr) {
+        if (!beginService(current_time)) {
+            return false;
+        }
+
+        // Создаем событие завершения обслуживания
+        events.push(Event(next_free_time, 1, current_client->id, id));
+        LW_COUNT("run/heap_push");
+        return true;
+    }
+
+    // Взять следующего клиента из очереди без события завершения (в режиме процессов
+    // окончание обслуживания отсчитывает сам процесс клиента)
+    bool beginService(double current_time) {
+        if (client_queue.empty() || current_client) {
             return false;
         }
 
-        current_client = new Client(client_queue.front());
+        current_client = client_queue.front();
         client_queue.pop();
+        queued_difficulty -= current_client->difficulty;
 
         next_free_time = current_time + current_client->difficulty;
         served_count++;
         total_work_time += current_client->difficulty;
 
-        // Создаем событие завершения обслуживания
-        events.push(Event(next_free_time, 1, current_client->id, id));
-
         updateLoad();
         return true;
     }
 
     // Завершить текущее обслуживание
     void finishService() {
-        delete current_client;
-        current_client = nullptr;
+        current_client.reset();
         updateLoad();
     }
 
@@ -113,16 +189,13 @@ public:
         current_load = 0.0;
 
         // Добавляем время дообслуживания текущего клиента
-        if (current_client != nullptr) {
+        if (current_client) {
             current_load += next_free_time;
         }
 
-        // Добавляем сложность всех клиентов в очереди
-        std::queue<Client> temp_queue = client_queue;
-        while (!temp_queue.empty()) {
-            current_load += temp_queue.front().difficulty;
-            temp_queue.pop();
-        }
+        // Добавляем сложность всех клиентов в очереди (сумма ведётся при
+        // постановке и снятии, без обхода очереди)
+        current_load += queued_difficulty;
     }
 
     // Получить текущую загрузку
@@ -132,7 +205,7 @@ public:
 
     // Проверить, свободен ли агент
     bool isFree(double current_time) const {
-        return current_client == nullptr || next_free_time <= current_time;
+        return !current_client || next_free_time <= current_time;
     }
 
     // Получить размер очереди
@@ -140,30 +213,399 @@ public:
         return client_queue.size();
     }
 
+    // Клиентов у агента: в очереди и на обслуживании
+    int getClientsInSystem() const {
+        return static_cast<int>(client_queue.size()) + (current_client ? 1 : 0);
+    }
+
+    // Время прибытия обслуживаемого клиента
+    double getCurrentArrivalTime() const {
+        return current_client ? current_client->arrival_time : 0.0;
+    }
+
+    // Процесс обслуживаемого клиента (-1, если клиента нет или он не процесс)
+    int getCurrentProcess() const {
+        return current_client ? current_client->process : -1;
+    }
+
     // Получить время освобождения
     double getNextFreeTime() const {
         return next_free_time;
     }
 };
 
+// Анализ выходной последовательности: отсечение разгона по MSER-5 и доверительный
+// интервал среднего методом пакетных средних по оставшимся наблюдениям.
+// Наблюдения не хранятся: средние по 5 копятся в не более чем MAX_BATCHES пакетах
+// (сумма и сумма квадратов), при заполнении соседние пакеты сливаются и размер пакета
+// удваивается. Память не зависит от числа клиентов; MSER-5 считается точно, но
+// точка отсечения выбирается на границах пакетов
+class SteadyStateMonitor {
+private:
+    static constexpr int MSER_BATCH = 5;
+    static constexpr int NUM_BATCHES = 20;
+    static constexpr int MAX_BATCHES = 1024;
+    static constexpr double T_QUANTILE = 2.093; // t(0.975; NUM_BATCHES - 1)
+    static constexpr long long MIN_OBSERVATIONS = 2000;
+    static constexpr long long DRIFT_OBSERVATIONS = 50000;
+
+    // Пакет из batch_size средних по MSER_BATCH наблюдений
+    struct Batch {
+        double sum = 0.0;    // сумма средних
+        double square = 0.0; // сумма их квадратов
+    };
+
+    std::vector<Batch> batches;  // заполненные пакеты
+    Batch current;               // заполняемый пакет
+    long long current_size = 0;  // средних в заполняемом пакете
+    long long batch_size = 1;    // средних в заполненном пакете
+    double pending = 0.0;        // сумма наблюдений, ещё не вошедших в среднее по 5
+    int pending_count = 0;
+    long long observed = 0;
+
+public:
+    struct Estimate {
+        long long warmup = 0;        // отброшено наблюдений разгона
+        bool drifting = false;       // MSER упёрся в границу: стационарности не видно
+        long long used = 0;          // наблюдений после отсечения (в заполненных пакетах)
+        double mean = 0.0;
+        double half_width = std::numeric_limits<double>::infinity(); // 95% интервал
+    };
+
+    SteadyStateMonitor() {
+        batches.reserve(MAX_BATCHES);
+    }
+
+    void observe(double value) {
+        observed++;
+        pending += value;
+        if (++pending_count < MSER_BATCH) {
+            return;
+        }
+        double z = pending / MSER_BATCH;
+        pending = 0.0;
+        pending_count = 0;
+
+        current.sum += z;
+        current.square += z * z;
+        if (++current_size < batch_size) {
+            return;
+        }
+        batches.push_back(current);
+        current = Batch();
+        current_size = 0;
+
+        if (batches.size() == MAX_BATCHES) {
+            for (size_t i = 0; i < MAX_BATCHES / 2; i++) {
+                batches[i].sum = batches[2 * i].sum + batches[2 * i + 1].sum;
+                batches[i].square = batches[2 * i].square + batches[2 * i + 1].square;
+            }
+            batches.resize(MAX_BATCHES / 2);
+            batch_size *= 2;
+        }
+    }
+
+    long long count() const {
+        return observed;
+    }
+
+    Estimate estimate() const {
+        Estimate result;
+        long long k = static_cast<long long>(batches.size());
+        if (k * batch_size < 2) {
+            return result;
+        }
+
+        // Суффиксные суммы средних по 5 и их квадратов по пакетам
+        std::vector<double> tail_sum(k + 1, 0.0), tail_square(k + 1, 0.0);
+        for (long long i = k - 1; i >= 0; i--) {
+            tail_sum[i] = tail_sum[i + 1] + batches[i].sum;
+            tail_square[i] = tail_square[i + 1] + batches[i].square;
+        }
+
+        // MSER(d) = сумма квадратов отклонений хвоста / (число средних в хвосте)^2,
+        // d - число отброшенных пакетов, не больше k / 2
+        long long best_d = 0;
+        double best_mser = std::numeric_limits<double>::infinity();
+        for (long long d = 0; d <= k / 2; d++) {
+            double rest = static_cast<double>((k - d) * batch_size);
+            double mean = tail_sum[d] / rest;
+            double mser = (tail_square[d] - rest * mean * mean) / (rest * rest);
+            if (mser < best_mser) {
+                best_mser = mser;
+                best_d = d;
+            }
+        }
+        result.warmup = best_d * batch_size * MSER_BATCH;
+        result.drifting = best_d == k / 2 && count() >= DRIFT_OBSERVATIONS;
+        result.used = (k - best_d) * batch_size * MSER_BATCH;
+        long long group = (k - best_d) / NUM_BATCHES;
+        if (result.used < MIN_OBSERVATIONS || group < 1) {
+            return result;
+        }
+
+        // Пакетные средние по NUM_BATCHES группам пакетов; остаток - в начале, отбрасывается
+        long long first = k - group * NUM_BATCHES;
+        double means[NUM_BATCHES];
+        double total = 0.0;
+        for (int b = 0; b < NUM_BATCHES; b++) {
+            double sum = 0.0;
+            for (long long i = 0; i < group; i++) {
+                sum += batches[first + b * group + i].sum;
+            }
+            means[b] = sum / (group * batch_size);
+            total += means[b];
+        }
+        result.mean = total / NUM_BATCHES;
+        double variance = 0.0;
+        for (double mean : means) {
+            variance += (mean - result.mean) * (mean - result.mean);
+        }
+        variance /= NUM_BATCHES - 1;
+        result.half_width = T_QUANTILE * std::sqrt(variance / NUM_BATCHES);
+        return result;
+    }
+};
+
+// Пул памяти для кадров сопрограмм-процессов. Кадры одной сопрограммы имеют один
+// размер, поэтому освобождённый кадр сразу подходит следующему процессу того же вида:
+// после разгона кадры берутся из свободных списков, без обращения к куче. Новая
+// память запрашивается блоками по 64 КиБ. Пул у каждого потока свой, кадр
+// освобождается в том же потоке, где создан
+class FramePool {
+private:
+    static constexpr size_t GRANULE = 64;
+    static constexpr size_t NUM_CLASSES = 16; // кадры до 1 КиБ, крупнее - из кучи
+    static constexpr size_t SLAB_SIZE = 64 * 1024;
+
+    struct FreeFrame {
+        FreeFrame* next;
+    };
+
+    FreeFrame* free_lists[NUM_CLASSES] = {};
+    std::vector<std::unique_ptr<std::byte[]>> slabs;
+    std::byte* slab_cursor = nullptr;
+    size_t slab_left = 0;
+    long long frames_allocated = 0;
+
+public:
+    static FramePool& local() {
+        thread_local FramePool pool;
+        return pool;
+    }
+
+    void* allocate(size_t size) {
+        frames_allocated++;
+        size_t index = (size + GRANULE - 1) / GRANULE - 1;
+        if (index >= NUM_CLASSES) {
+            return ::operator new(size);
+        }
+        if (FreeFrame* frame = free_lists[index]) {
+            free_lists[index] = frame->next;
+            return frame;
+        }
+
+        size_t bytes = (index + 1) * GRANULE;
+        if (slab_left < bytes) {
+            slabs.emplace_back(new std::byte[SLAB_SIZE]);
+            slab_cursor = slabs.back().get();
+            slab_left = SLAB_SIZE;
+            LW_COUNT("process/frame_slabs");
+        }
+        void* frame = slab_cursor;
+        slab_cursor += bytes;
+        slab_left -= bytes;
+        return frame;
+    }
+
+    void deallocate(void* memory, size_t size) noexcept {
+        size_t index = (size + GRANULE - 1) / GRANULE - 1;
+        if (index >= NUM_CLASSES) {
+            ::operator delete(memory);
+            return;
+        }
+        FreeFrame* frame = static_cast<FreeFrame*>(memory);
+        frame->next = free_lists[index];
+        free_lists[index] = frame;
+    }
+
+    // Всего выделено кадров и блоков памяти под них (блоки не возвращаются до конца потока)
+    long long getFramesAllocated() const {
+        return frames_allocated;
+    }
+
+    size_t getSlabCount() const {
+        return slabs.size();
+    }
+};
+
+// Процесс моделирования - сопрограмма C++20. Создаётся приостановленной, запускает
+// и возобновляет её очередь событий System (событие типа 2), кадр уничтожает
+// таблица процессов после завершения
+class Process {
+public:
+    struct promise_type;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    struct promise_type {
+        int slot = -1; // Номер в таблице процессов
+
+        Process get_return_object() {
+            return Process(Handle::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+        std::suspend_always final_suspend() noexcept {
+            return {};
+        }
+        void return_void() noexcept {
+        }
+        void unhandled_exception() {
+            throw; // Уходит из цикла событий; кадр уничтожит таблица процессов
+        }
+
+        static void* operator new(size_t size) {
+            return FramePool::local().allocate(size);
+        }
+        static void operator delete(void* memory, size_t size) noexcept {
+            FramePool::local().deallocate(memory, size);
+        }
+    };
+
+    Process(Process&& other) noexcept : handle(std::exchange(other.handle, {})) {
+    }
+    Process(const Process&) = delete;
+    Process& operator=(const Process&) = delete;
+
+    ~Process() {
+        if (handle) {
+            handle.destroy(); // Процесс так и не был запущен
+        }
+    }
+
+    // Передать кадр во владение таблице процессов
+    Handle release() {
+        return std::exchange(handle, {});
+    }
+
+private:
+    Handle handle;
+
+    explicit Process(Handle _handle) : handle(_handle) {
+    }
+};
+
+// Таблица живых процессов. В событии хранится номер процесса, а не указатель
+// на кадр, поэтому событие не растёт и цикл событий run() не дорожает
+class ProcessTable {
+private:
+    std::vector<Process::Handle> handles;
+    std::vector<int> free_slots;
+
+public:
+    ProcessTable() = default;
+    ProcessTable(const ProcessTable&) = delete;
+    ProcessTable& operator=(const ProcessTable&) = delete;
+
+    bool empty() const {
+        return handles.size() == free_slots.size();
+    }
+
+    ~ProcessTable() {
+        for (Process::Handle handle : handles) {
+            if (handle) {
+                handle.destroy();
+            }
+        }
+    }
+
+    int add(Process process) {
+        Process::Handle handle = process.release();
+        int slot;
+        if (free_slots.empty()) {
+            slot = static_cast<int>(handles.size());
+            handles.push_back(handle);
+        }
+        else {
+            slot = free_slots.back();
+            free_slots.pop_back();
+            handles[slot] = handle;
+        }
+        handle.promise().slot = slot;
+        return slot;
+    }
+
+    // Возобновить процесс; завершившийся процесс удаляется из таблицы
+    void resume(int slot) {
+        Process::Handle handle = handles[slot];
+        handle.resume();
+        if (handle.done()) {
+            handle.destroy();
+            handles[slot] = {};
+            free_slots.push_back(slot);
+        }
+    }
+};
+
+// Поведение клиента в режиме процессов: уход при длинной очереди и повторные попытки
+struct ClientBehaviour {
+    int balk_queue = 0;       // Длина очереди, при которой клиент уходит (0 - ждёт всегда)
+    int retries = 0;          // Повторных попыток после ухода
+    double retry_delay = 5.0; // Пауза перед повторной попыткой
+};
+
+// Вид отчёта: полная таблица, k лучших или худших агентов, сводные гистограммы
+// или полная таблица в двоичный файл .lwc
+enum class ReportMode { Full, Top, Bottom, Summary, Binary };
+
+struct ReportOptions {
+    ReportMode mode = ReportMode::Full;
+    int k = 10;           // для Top и Bottom
+    std::string path;     // для Binary
+};
+
+// Правило выбора агента для прибывшего клиента: наименьшая загрузка (сумма
+// сложностей) или наименьшее число клиентов у агента
+enum class DispatchPolicy { LeastLoaded, ShortestQueue };
+
+// Вариант ветки, разведённой из снимка: нулевые значения - как в снимке
+struct BranchVariant {
+    int n = 0;        // Агентов (не меньше, чем в снимке: новые агенты приходят свободными)
+    double a = 0.0;   // Границы интервала между клиентами
+    double b = 0.0;
+    DispatchPolicy policy = DispatchPolicy::LeastLoaded;
+};
+
 // Класс системы
 class System {
 private:
     int n; // Количество агентов
-    int m; // Количество клиентов для обслуживания
+    long long m; // Количество клиентов для обслуживания
     double a, b; // Параметры распределения времени между клиентами
 
     std::vector<Agent> agents;
     std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
     RandomGenerator rng;
 
-    int clients_created;
-    int clients_served;
+    long long clients_created;
+    long long clients_served;
+    long long events_processed;
+    ReportOptions report_options;
+    DispatchPolicy dispatch_policy;
+    double time_in_system; // Суммарное время пребывания клиентов, обслуженных в advance
+
+    // Режим процессов
+    ProcessTable processes;
+    double simulation_time;
+    ClientBehaviour behaviour;
+    long long clients_balked;
 
 public:
-    System(int _n, int _m, double _a, double _b)
-        : n(_n), m(_m), a(_a), b(_b), rng(_a, _b),
-        clients_created(0), clients_served(0) {
+    System(int _n, long long _m, double _a, double _b, unsigned seed = std::random_device{}())
+        : n(_n), m(_m), a(_a), b(_b), rng(_a, _b, seed),
+        clients_created(0), clients_served(0), events_processed(0),
+        dispatch_policy(DispatchPolicy::LeastLoaded), time_in_system(0.0), simulation_time(0.0), clients_balked(0) {
 
         // Создаем агентов
         for (int i = 0; i < n; i++) {
@@ -171,8 +613,102 @@ public:
         }
     }
 
+    // Снимок состояния для веток what-if: агенты с очередями (очереди всех агентов
+    // подряд в одном массиве), ожидающие события и состояние генератора. Снимок
+    // не меняется, поэтому из одного снимка ветки можно строить параллельно
+    struct Snapshot {
+        int n;
+        long long m;
+        double a, b;
+        RandomGenerator rng;
+        std::vector<Agent::State> agents;
+        std::vector<Client> queued;
+        std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+        long long clients_created;
+        long long clients_served;
+        long long events_processed;
+        double simulation_time;
+        DispatchPolicy dispatch_policy;
+        double time_in_system;
+
+        // Объём снимка в байтах (без учёта служебных полей контейнеров)
+        size_t bytes() const {
+            return sizeof(Snapshot) + agents.size() * sizeof(Agent::State)
+                + queued.size() * sizeof(Client) + events.size() * sizeof(Event);
+        }
+    };
+
+    // Ветка из снимка: та же траектория генератора (общие случайные числа для всех
+    // веток), изменены только параметры варианта. Ветка без изменений продолжает
+    // исходный прогон в точности
+    System(const Snapshot& state, const BranchVariant& variant)
+        : n(variant.n > 0 ? variant.n : state.n), m(state.m),
+        a(variant.a > 0.0 ? variant.a : state.a), b(variant.b > 0.0 ? variant.b : state.b),
+        events(state.events), rng(state.rng),
+        clients_created(state.clients_created), clients_served(state.clients_served),
+        events_processed(state.events_processed), dispatch_policy(variant.policy),
+        time_in_system(state.time_in_system), simulation_time(state.simulation_time), clients_balked(0) {
+        if (n < state.n) {
+            throw std::invalid_argument("ветка не может убрать агентов: у них остались бы клиенты");
+        }
+        rng.setTimeRange(a, b);
+
+        agents.reserve(n);
+        size_t offset = 0;
+        for (const Agent::State& agent : state.agents) {
+            agents.emplace_back(agent, state.queued.data() + offset);
+            offset += agent.queued;
+        }
+        for (int i = state.n; i < n; i++) {
+            agents.emplace_back(i);
+        }
+    }
+
+    Snapshot snapshot() const {
+        if (!processes.empty()) {
+            throw std::logic_error("снимок недоступен, пока идут процессы-сопрограммы");
+        }
+        Snapshot state{ n, m, a, b, rng, {}, {}, events, clients_created, clients_served,
+            events_processed, simulation_time, dispatch_policy, time_in_system };
+        state.agents.reserve(agents.size());
+        for (const auto& agent : agents) {
+            state.agents.push_back(agent.saveState(state.queued));
+        }
+        return state;
+    }
+
+    // Продвинуть моделирование до момента end_time (или до m обслуженных клиентов).
+    // Прибытия порождаются по одному, как в runToPrecision, поэтому в очереди событий
+    // не больше n + 1 события и снимок компактен; вызовы можно повторять
+    void advance(double end_time) {
+        LW_PHASE("advance");
+        if (clients_created == 0 && m > 0) {
+            events.push(nextArrival(0.0));
+        }
+
+        while (!events.empty() && events.top().time <= end_time && clients_served < m) {
+            Event event = events.top();
+            events.pop();
+            events_processed++;
+            simulation_time = event.time;
+
+            if (event.type == 0) {
+                handleArrival(event);
+                if (clients_created < m) {
+                    events.push(nextArrival(event.time));
+                }
+            }
+            else {
+                time_in_system += event.time - agents[event.agent_id].getCurrentArrivalTime();
+                handleDeparture(event);
+            }
+        }
+    }
+
     // Запуск моделирования
-    void run() {
+    void run(std::ostream& out = std::cout) {
+        LW_PHASE("run");
+
         // Создаем первого клиента
         createNextClient(0.0);
 
@@ -180,6 +716,8 @@ public:
         while (!events.empty() && clients_served < m) {
             Event event = events.top();
             events.pop();
+            events_processed++;
+            LW_COUNT("run/heap_pop");
 
             if (event.type == 0) { // Прибытие клиента
                 handleArrival(event);
@@ -190,30 +728,437 @@ public:
         }
 
         // Вывод результатов
-        printReport();
+        printReport(out);
+    }
+
+    // Консервативное параллельное моделирование: агенты разбиты на num_threads
+    // непрерывных групп, у каждой группы свой поток и своя очередь событий
+    // завершения обслуживания. Группы взаимодействуют только при распределении
+    // прибытий, а прибытия известны заранее (генерируются до начала прогона), поэтому
+    // окна синхронизации - промежутки между соседними прибытиями: внутри окна каждая
+    // группа обрабатывает свои события независимо. Завершение обслуживания порождает
+    // следующее событие не раньше чем через 1 (сложность >= 1) и только у того же
+    // агента, так что обмен событиями между группами не нужен. На границе окна группы
+    // сообщают своего наименее загруженного агента, и завершающая функция барьера
+    // выбирает общего (при равенстве - с меньшим номером, как в run()) и тянет
+    // сложность клиента из того же генератора в том же порядке. Результат совпадает
+    // с последовательным run(), кроме событий с точно равным временем, порядок
+    // которых и в run() не определён.
+    void runParallel(int num_threads, std::ostream& out = std::cout) {
+        LW_PHASE("run_parallel");
+        num_threads = std::max(1, std::min(num_threads, n));
+
+        std::vector<Event> arrivals = generateArrivals();
+
+        struct Partition {
+            int begin, end;
+            std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+            int best_agent = -1;
+            long long departures = 0;
+        };
+        std::vector<Partition> partitions(num_threads);
+        for (int g = 0; g < num_threads; g++) {
+            partitions[g].begin = static_cast<int>(static_cast<long long>(n) * g / num_threads);
+            partitions[g].end = static_cast<int>(static_cast<long long>(n) * (g + 1) / num_threads);
+        }
+
+        // Решение по текущему прибытию: кому достался клиент
+        int assigned_agent = -1;
+        Client assigned_client(0, 0.0, 0);
+        size_t next_arrival = 0;
+
+        auto dispatch = [&]() noexcept {
+            int best = partitions[0].best_agent;
+            for (int g = 1; g < num_threads; g++) {
+                int candidate = partitions[g].best_agent;
+                if (agents[candidate].getCurrentLoad() < agents[best].getCurrentLoad()) {
+                    best = candidate;
+                }
+            }
+            const Event& arrival = arrivals[next_arrival++];
+            assigned_agent = best;
+            assigned_client = Client(arrival.client_id, arrival.time, rng.getDifficulty());
+            LW_COUNT("run_parallel/windows");
+        };
+        std::barrier sync(num_threads, dispatch);
+
+        auto worker = [&](int g) {
+            Partition& part = partitions[g];
+            for (size_t j = 0; j <= arrivals.size(); j++) {
+                // Клиент, распределённый на прошлой границе окна
+                if (j > 0 && assigned_agent >= part.begin && assigned_agent < part.end) {
+                    Agent& agent = agents[assigned_agent];
+                    agent.addClient(assigned_client);
+                    if (agent.isFree(assigned_client.arrival_time)) {
+                        agent.startNextService(assigned_client.arrival_time, part.events);
+                    }
+                }
+
+                // Окно: все свои события до следующего прибытия
+                double horizon = j < arrivals.size() ? arrivals[j].time : std::numeric_limits<double>::infinity();
+                while (!part.events.empty() && part.events.top().time < horizon) {
+                    Event event = part.events.top();
+                    part.events.pop();
+                    completeService(agents[event.agent_id], event.time, part.events);
+                    part.departures++;
+                }
+                if (j == arrivals.size()) {
+                    break;
+                }
+
+                part.best_agent = findLeastLoaded(part.begin, part.end);
+                sync.arrive_and_wait();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (int g = 1; g < num_threads; g++) {
+            threads.emplace_back(worker, g);
+        }
+        worker(0);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        events_processed = static_cast<long long>(arrivals.size());
+        for (const auto& part : partitions) {
+            clients_served += part.departures;
+            events_processed += part.departures;
+        }
+
+        printReport(out);
+    }
+
+    // Моделирование до заданной точности: наблюдается время пребывания клиента
+    // в системе (ожидание + обслуживание). Прогон останавливается, когда после
+    // отсечения разгона (MSER-5) половина 95% интервала пакетных средних не
+    // превышает relative_precision от среднего, или после m обслуженных клиентов.
+    // Прибытия здесь порождаются по одному по ходу прогона, поэтому при том же
+    // зерне траектория отличается от run(), где все прибытия создаются заранее.
+    SteadyStateMonitor::Estimate runToPrecision(double relative_precision, std::ostream& out = std::cout) {
+        LW_PHASE("run_precision");
+        SteadyStateMonitor monitor;
+        SteadyStateMonitor::Estimate estimate;
+        long long next_check = 1000;
+        bool converged = false;
+        double end_time = 0.0;
+
+        if (m > 0) {
+            events.push(nextArrival(0.0));
+        }
+
+        while (!events.empty() && clients_served < m) {
+            Event event = events.top();
+            events.pop();
+            events_processed++;
+            end_time = event.time;
+
+            if (event.type == 0) {
+                handleArrival(event);
+                if (clients_created < m) {
+                    events.push(nextArrival(event.time));
+                }
+            }
+            else {
+                monitor.observe(event.time - agents[event.agent_id].getCurrentArrivalTime());
+                handleDeparture(event);
+
+                // Проверки с геометрическим шагом: суммарная стоимость линейна
+                if (monitor.count() >= next_check) {
+                    next_check += next_check / 2;
+                    estimate = monitor.estimate();
+                    if (estimate.half_width <= relative_precision * estimate.mean) {
+                        converged = true;
+                        break;
+                    }
+                    if (estimate.drifting) {
+                        break; // Перегрузка: очередь растёт, установившегося режима нет
+                    }
+                }
+            }
+        }
+        if (!converged) {
+            estimate = monitor.estimate();
+        }
+
+        // Отсечение разгона известно только в конце прогона, а счётчики агентов копятся
+        // с нуля: таблица агентов включает разгон, без него - только время пребывания ниже
+        out << "Статистика агентов за весь прогон, включая разгон:" << std::endl;
+        printReport(out);
+        out << std::fixed << std::setprecision(2);
+        out << "\nУстановившийся режим (время пребывания клиента в системе, без разгона):" << std::endl;
+        out << "  Отброшено как разгон: " << estimate.warmup << " из " << monitor.count() << " клиентов" << std::endl;
+        if (estimate.half_width < std::numeric_limits<double>::infinity()) {
+            out << "  Среднее: " << estimate.mean << " +- " << estimate.half_width
+                << " (95%, " << 100.0 * estimate.half_width / estimate.mean << "%)" << std::endl;
+        }
+        out << "  Модельное время: " << end_time << std::endl;
+        if (converged) {
+            out << "  Точность достигнута" << std::endl;
+        }
+        else if (estimate.drifting) {
+            out << "  Установившегося режима нет: показатель растёт (система перегружена)" << std::endl;
+        }
+        else {
+            out << "  Точность не достигнута за m клиентов" << std::endl;
+        }
+        return estimate;
+    }
+
+    // Воспроизведение записанного потока прибытий из файла .lwc со столбцами
+    // time (float64, по неубыванию) и difficulty (int32). Файл отображается в память,
+    // блоки читаются без копирования, следующий блок подкачивается заранее. Прибытия
+    // не попадают в очередь событий: они сливаются с завершениями обслуживания
+    // напрямую из отображённого столбца, в куче остаются только завершения (не больше n).
+    // При равенстве времён завершение обслуживания обрабатывается раньше прибытия.
+    void runTrace(const std::string& path, std::ostream& out = std::cout) {
+        LW_PHASE("replay");
+        ColumnarReader trace(path);
+        size_t time_column = trace.columnIndex("time");
+        size_t difficulty_column = trace.columnIndex("difficulty");
+        trace.adviseSequential();
+
+        m = clientLimit(trace.rowCount());
+        for (size_t k = 0; k < trace.chunkCount(); k++) {
+            trace.prefetchChunk(k + 1);
+            ColumnView<double> times = trace.column<double>(k, time_column);
+            ColumnView<std::int32_t> difficulties = trace.column<std::int32_t>(k, difficulty_column);
+
+            for (size_t i = 0; i < times.size(); i++) {
+                double arrival_time = times[i];
+                while (!events.empty() && events.top().time <= arrival_time) {
+                    Event event = events.top();
+                    events.pop();
+                    events_processed++;
+                    handleDeparture(event);
+                }
+
+                clients_created++;
+                events_processed++;
+                dispatch(Client(clients_created, arrival_time, difficulties[i]));
+            }
+        }
+
+        while (!events.empty()) {
+            Event event = events.top();
+            events.pop();
+            events_processed++;
+            handleDeparture(event);
+        }
+
+        printReport(out);
+    }
+
+    // Моделирование в терминах процессов: каждый клиент - сопрограмма clientProcess,
+    // прибытия порождает сопрограмма arrivalProcess. Прибытия и сложности берутся из
+    // генератора в том же порядке, что и в run(), поэтому без отказов (behaviour по
+    // умолчанию) отчёт совпадает с run() при том же зерне
+    void runProcesses(std::ostream& out = std::cout) {
+        LW_PHASE("run_processes");
+        spawn(arrivalProcess(generateArrivals()));
+
+        while (!events.empty()) {
+            Event event = events.top();
+            events.pop();
+            events_processed++;
+            simulation_time = event.time;
+            LW_COUNT("process/resume");
+            processes.resume(event.client_id);
+        }
+
+        printReport(out);
+        if (behaviour.balk_queue > 0) {
+            out << "Ушли без обслуживания: " << clients_balked << std::endl;
+        }
+    }
+
+    // Ожидание до момента time: процесс возобновится событием из общей очереди
+    struct Timeout {
+        System& system;
+        double time;
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+        void await_suspend(Process::Handle handle) {
+            system.schedule(handle.promise().slot, time);
+        }
+        void await_resume() const noexcept {
+        }
+    };
+
+    // Занять агента: клиент встаёт в его очередь, процесс ждёт начала обслуживания
+    // (если агент свободен - продолжает без приостановки)
+    struct Acquire {
+        System& system;
+        int agent;
+        Client client;
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+        bool await_suspend(Process::Handle handle) {
+            client.process = handle.promise().slot;
+            Agent& target = system.agents[agent];
+            target.addClient(client);
+            return !(target.isFree(system.simulation_time) && target.beginService(system.simulation_time));
+        }
+        void await_resume() const noexcept {
+        }
+    };
+
+    // Примитивы процессов: co_await delay(t), co_await until(t), co_await acquire(agent, client)
+    Timeout delay(double duration) {
+        return Timeout{ *this, simulation_time + duration };
+    }
+
+    Timeout until(double time) {
+        return Timeout{ *this, time };
+    }
+
+    Acquire acquire(int agent, const Client& client) {
+        return Acquire{ *this, agent, client };
+    }
+
+    // Освободить агента: следующий клиент из его очереди начинает обслуживание,
+    // а его процесс возобновляется в тот же момент
+    void release(int agent) {
+        Agent& target = agents[agent];
+        target.finishService();
+        if (target.isFree(simulation_time) && target.beginService(simulation_time)) {
+            schedule(target.getCurrentProcess(), simulation_time);
+        }
+    }
+
+    // Запустить процесс в момент time (по умолчанию - сейчас)
+    void spawn(Process process, double time = -1.0) {
+        schedule(processes.add(std::move(process)), time < 0.0 ? simulation_time : time);
+    }
+
+    double now() const {
+        return simulation_time;
+    }
+
+    void setClientBehaviour(const ClientBehaviour& _behaviour) {
+        behaviour = _behaviour;
+    }
+
+    long long getClientsServed() const {
+        return clients_served;
+    }
+
+    long long getClientsBalked() const {
+        return clients_balked;
+    }
+
+    // Отчёт по текущему состоянию (после advance)
+    void printResults(std::ostream& out = std::cout) {
+        printReport(out);
+    }
+
+    // Суммарное время пребывания в системе клиентов, обслуженных в advance
+    double getTimeInSystem() const {
+        return time_in_system;
+    }
+
+    void setDispatchPolicy(DispatchPolicy policy) {
+        dispatch_policy = policy;
+    }
+
+    // Клиентов, ждущих в очередях агентов
+    long long getQueuedClients() const {
+        long long queued = 0;
+        for (const auto& agent : agents) {
+            queued += agent.getQueueSize();
+        }
+        return queued;
+    }
+
+    // Число клиентов трассы по числу её строк. Счётчики клиентов - long long;
+    // трасса, которая в них не помещается, отвергается, а не обрезается молча
+    static long long clientLimit(std::uint64_t rows) {
+        if (rows > static_cast<std::uint64_t>(std::numeric_limits<long long>::max())) {
+            throw std::overflow_error("в трассе слишком много строк: " + std::to_string(rows));
+        }
+        return static_cast<long long>(rows);
+    }
+
+    // Вид отчёта, который печатают все режимы прогона
+    void setReportOptions(const ReportOptions& options) {
+        report_options = options;
+    }
+
+    // Число обработанных событий последнего прогона
+    long long getEventsProcessed() const {
+        return events_processed;
     }
 
 private:
-    // Создать следующего клиента
+    // Создать всех оставшихся клиентов (цикл вместо рекурсии: при большом m
+    // рекурсия глубиной m переполняла стек)
     void createNextClient(double current_time) {
-        if (clients_created >= m) {
-            return;
+        for (const Event& arrival : generateArrivals(current_time)) {
+            // Создаем событие прибытия
+            events.push(arrival);
+            LW_COUNT("run/heap_push");
+        }
+    }
+
+    // События прибытия всех оставшихся клиентов в порядке времени
+    std::vector<Event> generateArrivals(double current_time = 0.0) {
+        LW_TIMER("run/generate_clients");
+        std::vector<Event> arrivals;
+        arrivals.reserve(m - clients_created);
+
+        double arrival_time = current_time;
+        while (clients_created < m) {
+            arrivals.push_back(nextArrival(arrival_time));
+            arrival_time = arrivals.back().time;
         }
+        return arrivals;
+    }
 
-        double interval = (clients_created == 0) ? rng.getNextTime() : rng.getNextTime();
-        double arrival_time = current_time + interval;
+    // Следующий клиент после момента previous_time
+    Event nextArrival(double previous_time) {
+        double arrival_time = previous_time + rng.getNextTime();
         int difficulty = rng.getDifficulty();
 
         Client client(clients_created + 1, arrival_time, difficulty);
+        clients_created++;
+        return Event(arrival_time, 0, client.id);
+    }
 
-        // Создаем событие прибытия
-        events.push(Event(arrival_time, 0, client.id));
+    void schedule(int process, double time) {
+        events.push(Event(time, 2, process));
+        LW_COUNT("run/heap_push");
+    }
 
-        clients_created++;
+    // Источник клиентов: процесс на каждого клиента в момент его прибытия
+    Process arrivalProcess(std::vector<Event> arrivals) {
+        for (const Event& arrival : arrivals) {
+            co_await until(arrival.time);
+            spawn(clientProcess(arrival.client_id));
+        }
+    }
 
-        // Создаем следующего клиента, если нужно
-        if (clients_created < m) {
-            createNextClient(arrival_time);
+    // Клиент: выбирает наименее загруженного агента; если очередь к нему не короче
+    // behaviour.balk_queue - уходит и, пока есть попытки, возвращается через retry_delay
+    Process clientProcess(long long id) {
+        Client client(id, simulation_time, rng.getDifficulty());
+        for (int attempt = 0; ; attempt++) {
+            int agent = findLeastLoaded(0, n);
+            if (behaviour.balk_queue == 0 || agents[agent].getQueueSize() < behaviour.balk_queue) {
+                co_await acquire(agent, client);
+                co_await delay(client.difficulty);
+                release(agent);
+                clients_served++;
+                co_return;
+            }
+            if (attempt == behaviour.retries) {
+                clients_balked++;
+                co_return;
+            }
+            co_await delay(behaviour.retry_delay);
         }
     }
 
@@ -223,25 +1168,22 @@ private:
             return; // Не принимаем новых клиентов после m-го
         }
 
-        // Находим агента с минимальной загрузкой
-        int selected_agent = 0;
-        double min_load = agents[0].getCurrentLoad();
+        // Создаем клиента
+        Client client(event.client_id, event.time, rng.getDifficulty());
+        dispatch(client);
+    }
 
-        for (int i = 1; i < n; i++) {
-            double load = agents[i].getCurrentLoad();
-            if (load < min_load || (load == min_load && i < selected_agent)) {
-                min_load = load;
-                selected_agent = i;
-            }
-        }
+    // Передать клиента наименее загруженному агенту
+    void dispatch(const Client& client) {
+        double arrival_time = client.arrival_time;
 
-        // Создаем клиента
-        double arrival_time = event.time;
-        int difficulty = rng.getDifficulty();
-        Client client(event.client_id, arrival_time, difficulty);
+        // Находим агента с минимальной загрузкой (или с наименьшим числом клиентов)
+        int selected_agent = dispatch_policy == DispatchPolicy::LeastLoaded ? findLeastLoaded(0, n) : findShortestQueue();
 
         // Добавляем клиента к выбранному агенту
         agents[selected_agent].addClient(client);
+        LW_COUNT("run/arrivals");
+        LW_HISTOGRAM("run/queue_length", agents[selected_agent].getQueueSize());
 
         // Если агент свободен, начинаем обслуживание
         if (agents[selected_agent].isFree(arrival_time)) {
@@ -249,73 +1191,700 @@ private:
         }
     }
 
+    // Агент с минимальной загрузкой среди [begin, end); при равенстве - с меньшим номером
+    int findLeastLoaded(int begin, int end) const {
+        int selected_agent = begin;
+        double min_load = agents[begin].getCurrentLoad();
+
+        for (int i = begin + 1; i < end; i++) {
+            double load = agents[i].getCurrentLoad();
+            if (load < min_load) {
+                min_load = load;
+                selected_agent = i;
+            }
+        }
+        return selected_agent;
+    }
+
+    // Агент с наименьшим числом клиентов; при равенстве - с меньшим номером
+    int findShortestQueue() const {
+        int selected_agent = 0;
+        int min_clients = agents[0].getClientsInSystem();
+
+        for (int i = 1; i < n && min_clients > 0; i++) {
+            int clients = agents[i].getClientsInSystem();
+            if (clients < min_clients) {
+                min_clients = clients;
+                selected_agent = i;
+            }
+        }
+        return selected_agent;
+    }
+
     // Обработка завершения обслуживания
     void handleDeparture(const Event& event) {
-        int agent_id = event.agent_id;
+        completeService(agents[event.agent_id], event.time, events);
+        clients_served++;
+    }
 
+    // Завершить обслуживание и, если очередь не пуста, начать следующее;
+    // новое событие кладётся в переданную очередь (общую или очередь раздела)
+    static void completeService(Agent& agent, double time,
+        std::priority_queue<Event, std::vector<Event>, std::greater<Event>>& queue) {
         // Завершаем текущее обслуживание
-        agents[agent_id].finishService();
-        clients_served++;
+        agent.finishService();
+        LW_COUNT("run/departures");
 
         // Если агент свободен и в его очереди есть клиенты, начинаем следующее обслуживание
-        if (agents[agent_id].isFree(event.time) && agents[agent_id].getQueueSize() > 0) {
-            agents[agent_id].startNextService(event.time, events);
+        if (agent.isFree(time) && agent.getQueueSize() > 0) {
+            agent.startNextService(time, queue);
         }
     }
 
     // Вывод отчета
-    void printReport() {
-        std::cout << "Отчет о работе агентов:" << std::endl;
-        std::cout << "=======================" << std::endl;
+    void printReport(std::ostream& out) {
+        LW_TIMER("run/report");
+        out << "Отчет о работе агентов:" << std::endl;
+        out << "=======================" << std::endl;
 
-        // Собираем статистику
-        struct ReportEntry {
-            int id;
-            int served_count;
-            double total_time;
-        };
+        if (report_options.mode == ReportMode::Summary) {
+            printSummary(out);
+        }
+        else if (report_options.mode == ReportMode::Binary) {
+            writeBinaryReport();
+            out << "Таблица агентов записана в " << report_options.path << "\n";
+        }
+        else {
+            printTable(out);
+        }
+
+        out << "\nВсего обслужено клиентов: " << clients_served << std::endl;
+    }
 
+    struct ReportEntry {
+        int id;
+        long long served_count;
+        double total_time;
+    };
+
+    // Таблица агентов: полная (сортировка) или k лучших/худших (частичная сортировка).
+    // Строки собираются в буфер без std::setw и std::endl и выводятся крупными кусками
+    void printTable(std::ostream& out) {
+        // Собираем статистику
         std::vector<ReportEntry> report;
+        report.reserve(agents.size());
         for (const auto& agent : agents) {
             report.push_back({ agent.id, agent.served_count, agent.total_work_time });
         }
 
         // Сортируем по убыванию количества клиентов, при равенстве - по возрастанию времени
-        std::sort(report.begin(), report.end(), [](const ReportEntry& a, const ReportEntry& b) {
+        auto better = [](const ReportEntry& a, const ReportEntry& b) {
             if (a.served_count != b.served_count) {
                 return a.served_count > b.served_count;
             }
             return a.total_time < b.total_time;
-            });
+        };
+        size_t rows = report.size();
+        if (report_options.mode == ReportMode::Full) {
+            std::sort(report.begin(), report.end(), better);
+        }
+        else {
+            rows = std::min(rows, static_cast<size_t>(std::max(0, report_options.k)));
+            if (report_options.mode == ReportMode::Top) {
+                std::partial_sort(report.begin(), report.begin() + rows, report.end(), better);
+            }
+            else {
+                std::partial_sort(report.begin(), report.begin() + rows, report.end(),
+                    [&](const ReportEntry& a, const ReportEntry& b) { return better(b, a); });
+            }
+            out << (report_options.mode == ReportMode::Top ? "Лучшие " : "Худшие ") << rows
+                << " из " << report.size() << " агентов\n";
+        }
 
         // Выводим результаты
-        std::cout << std::left << std::setw(10) << "ID агента"
+        out << std::left << std::setw(10) << "ID агента"
             << std::setw(20) << "Клиентов обслужено"
             << std::setw(20) << "Время работы" << std::endl;
-        std::cout << std::string(50, '-') << std::endl;
+        out << std::string(50, '-') << std::endl;
+
+        std::string buffer;
+        buffer.reserve(1 << 20);
+        for (size_t i = 0; i < rows; i++) {
+            appendPadded(buffer, report[i].id, 10);
+            appendPadded(buffer, report[i].served_count, 20);
+            appendPadded(buffer, report[i].total_time, 20);
+            buffer += '\n';
+            if (buffer.size() >= (1 << 20) - 64) {
+                out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                buffer.clear();
+            }
+        }
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    }
+
+    // Значение по левому краю поля ширины width (как std::left << std::setw);
+    // вещественные - с двумя знаками после точки независимо от локали
+    template <class T>
+    static void appendPadded(std::string& buffer, T value, size_t width) {
+        char text[64];
+        std::to_chars_result result;
+        if constexpr (std::is_floating_point_v<T>) {
+            result = std::to_chars(text, text + sizeof(text), value, std::chars_format::fixed, 2);
+        }
+        else {
+            result = std::to_chars(text, text + sizeof(text), value);
+        }
+        size_t length = static_cast<size_t>(result.ptr - text);
+        buffer.append(text, length);
+        if (length < width) {
+            buffer.append(width - length, ' ');
+        }
+    }
+
+    // Сводка без построчного вывода: распределения числа клиентов и времени работы
+    void printSummary(std::ostream& out) const {
+        std::vector<double> served, work;
+        served.reserve(agents.size());
+        work.reserve(agents.size());
+        for (const auto& agent : agents) {
+            served.push_back(agent.served_count);
+            work.push_back(agent.total_work_time);
+        }
+        out << "Агентов: " << agents.size() << "\n";
+        printHistogram(out, "Клиентов обслужено", served);
+        printHistogram(out, "Время работы", work);
+    }
+
+    static void printHistogram(std::ostream& out, const std::string& title, const std::vector<double>& values) {
+        const int bins = 20;
+        auto [low_it, high_it] = std::minmax_element(values.begin(), values.end());
+        double low = values.empty() ? 0.0 : *low_it;
+        double high = values.empty() ? 0.0 : *high_it;
+        double sum = 0.0;
+        for (double value : values) sum += value;
+
+        std::vector<long long> counts(bins, 0);
+        double width = high > low ? (high - low) / bins : 1.0;
+        for (double value : values) {
+            int bin = static_cast<int>((value - low) / width);
+            counts[std::min(bin, bins - 1)]++;
+        }
+
+        out << "\n" << title << ": мин " << low << ", макс " << high
+            << ", среднее " << (values.empty() ? 0.0 : sum / values.size()) << "\n";
+        long long peak = *std::max_element(counts.begin(), counts.end());
+        for (int i = 0; i < bins; i++) {
+            if (high == low && i > 0) break;
+            int bar = peak > 0 ? static_cast<int>(40 * counts[i] / peak) : 0;
+            out << "  [" << std::setw(10) << low + i * width << ", " << std::setw(10) << low + (i + 1) * width
+                << ") " << std::setw(10) << counts[i] << " " << std::string(bar, '#') << "\n";
+        }
+    }
+
+    // Полная таблица в колоночный файл .lwc (без сортировки, в порядке номеров)
+    void writeBinaryReport() const {
+        ColumnarWriter writer(report_options.path, {
+            { "id", ColumnType::Int32 },
+            { "served_count", ColumnType::Int64 },
+            { "total_work_time", ColumnType::Float64 } });
+        for (const auto& agent : agents) {
+            writer.addRow(static_cast<std::int32_t>(agent.id), static_cast<std::int64_t>(agent.served_count),
+                agent.total_work_time);
+        }
+    }
+};
+
+// Преобразование трассы прибытий из CSV ("time,difficulty", заголовок необязателен)
+// в .lwc для runTrace; время должно не убывать, сложность - не меньше 1
+void convertTrace(const std::string& csv_path, const std::string& lwc_path) {
+    std::ifstream in(csv_path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("не удалось открыть " + csv_path);
+    }
+    ColumnarWriter writer(lwc_path, { { "time", ColumnType::Float64 }, { "difficulty", ColumnType::Int32 } });
 
-        for (const auto& entry : report) {
-            std::cout << std::left << std::setw(10) << entry.id
-                << std::setw(20) << entry.served_count
-                << std::setw(20) << std::fixed << std::setprecision(2)
-                << entry.total_time << std::endl;
+    std::string line;
+    long long row = 0;
+    double previous = -std::numeric_limits<double>::infinity();
+    while (std::getline(in, line)) {
+        row++;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+
+        const char* begin = line.data();
+        const char* end = begin + line.size();
+        double time = 0.0;
+        std::int32_t difficulty = 0;
+        auto parsed_time = std::from_chars(begin, end, time);
+        bool ok = parsed_time.ec == std::errc() && parsed_time.ptr != end && *parsed_time.ptr == ',';
+        if (ok) {
+            auto parsed_difficulty = std::from_chars(parsed_time.ptr + 1, end, difficulty);
+            ok = parsed_difficulty.ec == std::errc() && parsed_difficulty.ptr == end;
+        }
+        if (!ok) {
+            if (row == 1) continue; // заголовок
+            throw std::runtime_error("строка " + std::to_string(row) + ": ожидается time,difficulty");
+        }
+        if (time < previous || difficulty < 1) {
+            throw std::runtime_error("строка " + std::to_string(row) + ": время убывает или сложность меньше 1");
         }
+        previous = time;
+        writer.addRow(time, difficulty);
+    }
+}
 
-        std::cout << "\nВсего обслужено клиентов: " << clients_served << std::endl;
+// Синтетическая трасса того же распределения, что у RandomGenerator (для проверки и замеров)
+void generateTrace(const std::string& lwc_path, long long rows, double a, double b, unsigned seed) {
+    RandomGenerator rng(a, b, seed);
+    ColumnarWriter writer(lwc_path, { { "time", ColumnType::Float64 }, { "difficulty", ColumnType::Int32 } });
+    double time = 0.0;
+    for (long long i = 0; i < rows; i++) {
+        time += rng.getNextTime();
+        writer.addRow(time, static_cast<std::int32_t>(rng.getDifficulty()));
     }
+}
+
+// Масштабирование параллельного режима: время и совпадение отчёта с run()
+void runScalingBenchmark(int n, long long m) {
+    const double a = 0.5, b = 2.0;
+    const unsigned seed = 2024;
+
+    auto timed = [&](int threads, std::string& report, long long& events) {
+        std::ostringstream out;
+        System system(n, m, a, b, seed);
+        auto start = std::chrono::steady_clock::now();
+        if (threads == 0) {
+            system.run(out);
+        }
+        else {
+            system.runParallel(threads, out);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        report = out.str();
+        events = system.getEventsProcessed();
+        return seconds;
+    };
+
+    std::string reference;
+    long long reference_events = 0;
+    double sequential = timed(0, reference, reference_events);
+
+    std::cout << "Параллельный режим: n=" << n << ", m=" << m
+        << ", ядер: " << std::thread::hardware_concurrency() << "\n";
+    std::cout << "threads,seconds,events_per_second,speedup,identical\n";
+    std::cout << "seq," << sequential << "," << reference_events / sequential << ",1,1\n";
+
+    int max_threads = std::max(8, static_cast<int>(std::thread::hardware_concurrency()));
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        std::string report;
+        long long events = 0;
+        double seconds = timed(threads, report, events);
+        std::cout << threads << "," << seconds << "," << events / seconds << ","
+            << sequential / seconds << "," << (report == reference && events == reference_events) << std::endl;
+    }
+}
+
+// Выполнить body(0..count-1) в num_threads потоках; номера раздаются по одному
+template <class Body>
+void forEachParallel(size_t count, int num_threads, Body body) {
+    std::atomic<size_t> next{ 0 };
+    auto worker = [&] {
+        for (size_t i = next++; i < count; i = next++) {
+            body(i);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int t = 1; t < num_threads; t++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+// Итог ветки what-if после разгона
+struct BranchResult {
+    long long clients_served = 0; // Обслужено за ветку (без разгона)
+    long long queued = 0;     // Ждут в очередях в конце ветки
+    long long events = 0;     // Событий за ветку
+    double mean_time_in_system = 0.0; // Среднее время пребывания обслуженных за ветку
 };
 
-int main() {
+// Ветки из общего снимка до момента end_time, параллельно в num_threads потоках
+std::vector<BranchResult> runBranches(const System::Snapshot& state, const std::vector<BranchVariant>& variants,
+    double end_time, int num_threads) {
+    for (const BranchVariant& variant : variants) {
+        if (variant.n > 0 && variant.n < state.n) {
+            throw std::invalid_argument("ветка не может убрать агентов: у них остались бы клиенты");
+        }
+    }
+    std::vector<BranchResult> results(variants.size());
+    forEachParallel(variants.size(), num_threads, [&](size_t i) {
+        System branch(state, variants[i]);
+        branch.advance(end_time);
+        long long served = branch.getClientsServed() - state.clients_served;
+        results[i] = { served, branch.getQueuedClients(), branch.getEventsProcessed() - state.events_processed,
+            served > 0 ? (branch.getTimeInSystem() - state.time_in_system) / served : 0.0 };
+    });
+    return results;
+}
+
+// Сетка вариантов для what-if: n, n+1, n+2, n+3 агентов, интервал между клиентами
+// в 1, 0.95, 0.9 от исходного, оба правила распределения
+std::vector<BranchVariant> whatIfVariants(int n, double a, double b) {
+    std::vector<BranchVariant> variants;
+    for (double scale : { 1.0, 0.95, 0.9 }) {
+        for (int extra = 0; extra < 4; extra++) {
+            for (DispatchPolicy policy : { DispatchPolicy::LeastLoaded, DispatchPolicy::ShortestQueue }) {
+                variants.push_back({ n + extra, a * scale, b * scale, policy });
+            }
+        }
+    }
+    return variants;
+}
+
+// Свип what-if: один разгон до warmup, ветки до warmup + horizon; для сравнения
+// те же варианты с нуля (каждый со своими параметрами с самого начала)
+void runWhatIfSweep(int n, double warmup, double horizon, int num_threads) {
+    const double a = 0.5, b = 2.0;
+    const unsigned seed = 2024;
+    const long long unlimited = std::numeric_limits<long long>::max();
+    std::vector<BranchVariant> variants = whatIfVariants(n, a, b);
+    auto seconds_since = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    System base(n, unlimited, a, b, seed);
+    base.advance(warmup);
+    System::Snapshot state = base.snapshot();
+    double warmup_seconds = seconds_since(start);
+    start = std::chrono::steady_clock::now();
+    std::vector<BranchResult> results = runBranches(state, variants, warmup + horizon, num_threads);
+    double branch_seconds = seconds_since(start);
+
+    start = std::chrono::steady_clock::now();
+    forEachParallel(variants.size(), num_threads, [&](size_t i) {
+        System scratch(variants[i].n, unlimited, variants[i].a, variants[i].b, seed);
+        scratch.setDispatchPolicy(variants[i].policy);
+        scratch.advance(warmup + horizon);
+    });
+    double scratch_seconds = seconds_since(start);
+
+    // Ветка без изменений должна в точности продолжать непрерывный прогон
+    std::ostringstream straight_report, branch_report;
+    System straight(n, unlimited, a, b, seed);
+    straight.advance(warmup + horizon);
+    straight.printResults(straight_report);
+    System unchanged(state, BranchVariant{});
+    unchanged.advance(warmup + horizon);
+    unchanged.printResults(branch_report);
+
+    std::cout << "What-if: n=" << n << ", разгон до t=" << warmup << ", ветки до t=" << warmup + horizon
+        << ", веток: " << variants.size() << ", потоков: " << num_threads << "\n";
+    std::cout << "Снимок: " << state.bytes() << " байт, клиентов в очередях: " << state.queued.size()
+        << ", событий: " << state.events.size() << "\n";
+    std::cout << "n,a,b,policy,served,queued,events,mean_time_in_system\n";
+    for (size_t i = 0; i < variants.size(); i++) {
+        std::cout << variants[i].n << "," << variants[i].a << "," << variants[i].b << ","
+            << (variants[i].policy == DispatchPolicy::LeastLoaded ? "least_loaded" : "shortest_queue") << ","
+            << results[i].clients_served << "," << results[i].queued << "," << results[i].events << ","
+            << results[i].mean_time_in_system << "\n";
+    }
+    std::cout << "Разгон: " << warmup_seconds << " с, ветки: " << branch_seconds << " с, всего: "
+        << warmup_seconds + branch_seconds << " с\n";
+    std::cout << "Каждый вариант с нуля: " << scratch_seconds << " с (в "
+        << scratch_seconds / (warmup_seconds + branch_seconds) << " раз дольше)\n";
+    std::cout << "Ветка без изменений совпадает с непрерывным прогоном: "
+        << (straight_report.str() == branch_report.str() ? "да" : "нет") << std::endl;
+}
+
+// Самопроверка счётчиков клиентов за пределом int без прогона миллиардов строк:
+// число строк трассы и счётчики подставляются через clientLimit и снимок состояния
+int runSelfTest() {
+    const double a = 0.5, b = 2.0;
+    const long long beyond_int = static_cast<long long>(std::numeric_limits<int>::max()) + 1;
+    int failures = 0;
+    auto check = [&](bool condition, const std::string& what) {
+        std::cout << (condition ? "ok     " : "ОШИБКА ") << what << std::endl;
+        failures += condition ? 0 : 1;
+    };
+
+    // Число строк трассы больше INT_MAX проходит без сужения, непомещающееся - отвергается
+    check(System::clientLimit(static_cast<std::uint64_t>(beyond_int)) == beyond_int, "clientLimit(INT_MAX + 1)");
+    check(System::clientLimit(5000000000ULL) == 5000000000LL, "clientLimit(5e9)");
+    bool rejected = false;
+    try {
+        System::clientLimit(std::numeric_limits<std::uint64_t>::max());
+    }
+    catch (const std::overflow_error&) {
+        rejected = true;
+    }
+    check(rejected, "clientLimit(UINT64_MAX) отвергается");
+
+    // Условие остановки при m больше INT_MAX: при сужении до int m стал бы отрицательным
+    // и прогон не начался бы
+    System limited(3, System::clientLimit(3000000000ULL), a, b, 7);
+    limited.advance(1000.0);
+    check(limited.getClientsServed() > 0, "прогон с m = 3e9 идёт");
+
+    // Счётчики за INT_MAX: снимок с подставленными значениями и ещё немного клиентов
+    System base(3, std::numeric_limits<long long>::max(), a, b, 7);
+    base.advance(100.0);
+    System::Snapshot state = base.snapshot();
+    state.clients_created += beyond_int;
+    state.clients_served += beyond_int;
+    for (auto& agent : state.agents) {
+        agent.served_count += beyond_int;
+    }
+    System branch(state, BranchVariant{});
+    branch.advance(200.0);
+    check(branch.getClientsServed() > state.clients_served, "clients_served растёт после INT_MAX");
+    std::ostringstream report;
+    branch.printResults(report);
+    check(report.str().find("Всего обслужено клиентов: " + std::to_string(branch.getClientsServed())) != std::string::npos,
+        "отчёт печатает счётчик больше INT_MAX");
+
+    Event event(0.0, 0, beyond_int + 5);
+    check(event.client_id == beyond_int + 5 && sizeof(Event) == 24, "номер клиента в событии без сужения, событие 24 байта");
+
+    return failures == 0 ? 0 : 1;
+}
+
+#ifdef LW_BENCHMARK
+// Процесс, который только ждёт: steps раз по delay(1)
+Process tickerProcess(System& system, int steps) {
+    for (int i = 0; i < steps; i++) {
+        co_await system.delay(1.0);
+    }
+}
+
+// Эталонные замеры цикла событий: фиксированное зерно, несколько масштабов
+void runBenchmarks(BenchmarkSuite& suite) {
+    const double a = 0.5, b = 2.0;
+    const unsigned seed = 2024;
+    struct Scale { int n; int m; };
+    for (Scale scale : { Scale{ 3, 10000 }, Scale{ 10, 100000 }, Scale{ 50, 200000 } }) {
+        suite.measure("run_n" + std::to_string(scale.n) + "_m" + std::to_string(scale.m), "events/s", [&] {
+            std::ostringstream report;
+            System system(scale.n, scale.m, a, b, seed);
+            system.run(report);
+            return system.getEventsProcessed();
+        });
+    }
+
+    // Процессы-сопрограммы против обработчиков событий на одной модели: отчёт тот же,
+    // разница - цена переключения сопрограмм и лишних событий возобновления
+    for (Scale scale : { Scale{ 10, 100000 }, Scale{ 50, 200000 } }) {
+        std::string suffix = "_n" + std::to_string(scale.n) + "_m" + std::to_string(scale.m);
+        suite.measure("handlers" + suffix, "clients/s", [&] {
+            std::ostringstream report;
+            System system(scale.n, scale.m, a, b, seed);
+            system.run(report);
+            return system.getClientsServed();
+        });
+        suite.measure("processes" + suffix, "clients/s", [&] {
+            std::ostringstream report;
+            System system(scale.n, scale.m, a, b, seed);
+            system.runProcesses(report);
+            return system.getClientsServed();
+        });
+    }
+
+    // Чистая цена переключения при одинаковой куче: 64 процесса по delay(1) против
+    // 64 цепочек событий, каждое из которых обработчик перепланирует на время + 1
+    const int chains = 64, steps = 20000;
+    suite.measure("switch_processes", "events/s", [&] {
+        std::ostringstream report;
+        System system(1, 0, a, b, seed);
+        for (int i = 0; i < chains; i++) {
+            system.spawn(tickerProcess(system, steps), i / static_cast<double>(chains));
+        }
+        system.runProcesses(report);
+        return system.getEventsProcessed();
+    });
+    suite.measure("switch_handlers", "events/s", [&] {
+        std::priority_queue<Event, std::vector<Event>, std::greater<Event>> queue;
+        std::vector<int> remaining(chains, steps);
+        for (int i = 0; i < chains; i++) {
+            queue.push(Event(i / static_cast<double>(chains), 1, i));
+        }
+        long long processed = 0;
+        while (!queue.empty()) {
+            Event event = queue.top();
+            queue.pop();
+            processed++;
+            if (remaining[event.client_id]-- > 0) {
+                queue.push(Event(event.time + 1.0, 1, event.client_id));
+            }
+        }
+        return processed;
+    });
+
+    // What-if: 8 вариантов из одного разгона против 8 прогонов с нуля (в одном потоке)
+    std::vector<BranchVariant> variants = whatIfVariants(5, a, b);
+    variants.resize(8);
+    const double warmup = 100000.0, horizon = 5000.0;
+    suite.measure("whatif_forked", "branches/s", [&] {
+        System base(5, std::numeric_limits<long long>::max(), a, b, seed);
+        base.advance(warmup);
+        runBranches(base.snapshot(), variants, warmup + horizon, 1);
+        return static_cast<long long>(variants.size());
+    });
+    suite.measure("whatif_scratch", "branches/s", [&] {
+        for (const BranchVariant& variant : variants) {
+            System scratch(variant.n, std::numeric_limits<long long>::max(), variant.a, variant.b, seed);
+            scratch.setDispatchPolicy(variant.policy);
+            scratch.advance(warmup + horizon);
+        }
+        return static_cast<long long>(variants.size());
+    });
+
+    // Воспроизведение трассы: пропускная способность должна упираться в цикл событий
+    const std::string trace_path = "bench_lw_a_1_trace.lwc";
+    generateTrace(trace_path, 1000000, a, b, seed);
+    suite.measure("replay_n10_m1000000", "events/s", [&] {
+        std::ostringstream report;
+        System system(10, 0, a, b, seed);
+        system.runTrace(trace_path, report);
+        return system.getEventsProcessed();
+    });
+    std::remove(trace_path.c_str());
+}
+#endif
+
+int main(int argc, char* argv[]) {
     setlocale(LC_ALL, "Russian");
+#ifdef LW_BENCHMARK
+    return runBenchmarkMain(argc, argv, "lw_a_1", runBenchmarks);
+#endif
     // Параметры системы
     int n = 3;    // Количество агентов
-    int m = 10;   // Количество клиентов для обслуживания
+    long long m = 10; // Количество клиентов для обслуживания
     double a = 0.5; // Минимальное время между клиентами
     double b = 2.0; // Максимальное время между клиентами
 
-    // Создание и запуск системы
-    System system(n, m, a, b);
-    system.run();
+    try {
+        // Самопроверка счётчиков (запускается ctest): "selftest"
+        if (argc > 1 && std::string(argv[1]) == "selftest") {
+            return runSelfTest();
+        }
+
+        // Масштабирование параллельного режима: "scaling [n m]"
+        if (argc > 1 && std::string(argv[1]) == "scaling") {
+            runScalingBenchmark(argc > 2 ? std::stoi(argv[2]) : 20000, argc > 3 ? std::stoll(argv[3]) : 50000);
+            return 0;
+        }
+
+        // Трассы прибытий: "trace2lwc in.csv out.lwc", "gentrace out.lwc rows [seed]",
+        // "replay trace.lwc [n]"
+        if (argc > 3 && std::string(argv[1]) == "trace2lwc") {
+            convertTrace(argv[2], argv[3]);
+            return 0;
+        }
+        if (argc > 3 && std::string(argv[1]) == "gentrace") {
+            generateTrace(argv[2], std::stoll(argv[3]), a, b, argc > 4 ? static_cast<unsigned>(std::stoul(argv[4])) : 2024);
+            return 0;
+        }
+        if (argc > 2 && std::string(argv[1]) == "replay") {
+            System system(argc > 3 ? std::stoi(argv[3]) : n, 0, a, b);
+            auto start = std::chrono::steady_clock::now();
+            system.runTrace(argv[2]);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "Обработано событий: " << system.getEventsProcessed() << " за " << seconds << " с ("
+                << system.getEventsProcessed() / seconds << " событий/с)" << std::endl;
+            return 0;
+        }
+
+        // Отчёт для больших систем: "report full|top|bottom|summary|binary n m [k | файл.lwc]"
+        if (argc > 4 && std::string(argv[1]) == "report") {
+            std::string mode = argv[2];
+            ReportOptions options;
+            if (mode == "full") options.mode = ReportMode::Full;
+            else if (mode == "top") options.mode = ReportMode::Top;
+            else if (mode == "bottom") options.mode = ReportMode::Bottom;
+            else if (mode == "summary") options.mode = ReportMode::Summary;
+            else if (mode == "binary") options.mode = ReportMode::Binary;
+            else throw std::invalid_argument("вид отчёта: full, top, bottom, summary или binary");
+            if (argc > 5) {
+                if (options.mode == ReportMode::Binary) options.path = argv[5];
+                else options.k = std::stoi(argv[5]);
+            }
+            if (options.mode == ReportMode::Binary && options.path.empty()) {
+                options.path = "agents.lwc";
+            }
+
+            System system(std::stoi(argv[3]), std::stoll(argv[4]), a, b, 2024);
+            system.setReportOptions(options);
+            auto start = std::chrono::steady_clock::now();
+            system.run();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cerr << "Моделирование и отчёт: " << seconds << " с" << std::endl;
+            return 0;
+        }
+
+        // Процессы-сопрограммы: "processes [n m balk_queue retries seed]"
+        if (argc > 1 && std::string(argv[1]) == "processes") {
+            ClientBehaviour behaviour;
+            behaviour.balk_queue = argc > 4 ? std::stoi(argv[4]) : 0;
+            behaviour.retries = argc > 5 ? std::stoi(argv[5]) : 0;
+            unsigned seed = argc > 6 ? static_cast<unsigned>(std::stoul(argv[6])) : std::random_device{}();
+            System system(argc > 2 ? std::stoi(argv[2]) : n, argc > 3 ? std::stoll(argv[3]) : m, a, b, seed);
+            system.setClientBehaviour(behaviour);
+            auto start = std::chrono::steady_clock::now();
+            system.runProcesses();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            const FramePool& pool = FramePool::local();
+            std::cout << "Обработано событий: " << system.getEventsProcessed() << " за " << seconds << " с" << std::endl;
+            std::cout << "Кадров сопрограмм: " << pool.getFramesAllocated() << ", блоков памяти под них: "
+                << pool.getSlabCount() << std::endl;
+            return 0;
+        }
+
+        // Ветки what-if из одного разгона: "whatif [n warmup horizon threads]"
+        if (argc > 1 && std::string(argv[1]) == "whatif") {
+            runWhatIfSweep(argc > 2 ? std::stoi(argv[2]) : 5, argc > 3 ? std::stod(argv[3]) : 200000.0,
+                argc > 4 ? std::stod(argv[4]) : 20000.0,
+                argc > 5 ? std::stoi(argv[5]) : std::max(1, static_cast<int>(std::thread::hardware_concurrency())));
+            return 0;
+        }
+
+        // До заданной точности: "steady [n precision max_clients seed]"
+        if (argc > 1 && std::string(argv[1]) == "steady") {
+            int agents_count = argc > 2 ? std::stoi(argv[2]) : 10;
+            double precision = argc > 3 ? std::stod(argv[3]) : 0.01;
+            long long max_clients = argc > 4 ? std::stoll(argv[4]) : 10000000;
+            unsigned seed = argc > 5 ? static_cast<unsigned>(std::stoul(argv[5])) : std::random_device{}();
+            System system(agents_count, max_clients, a, b, seed);
+            system.runToPrecision(precision);
+            std::cout << "Обработано событий: " << system.getEventsProcessed() << std::endl;
+            return 0;
+        }
+
+        // С зерном в командной строке прогон детерминирован, и отчёт берётся из кэша
+        if (argc > 1) {
+            unsigned seed = static_cast<unsigned>(std::stoul(argv[1]));
+            ResultCache cache;
+            std::string key = CacheKey("queue-1").add("n", n).add("m", m)
+                .add("a", a).add("b", b).add("seed", seed).str();
+            std::cout << cache.text(key, [&] {
+                std::ostringstream out;
+                System system(n, m, a, b, seed);
+                system.run(out);
+                return out.str();
+            });
+            return 0;
+        }
+
+        // Создание и запуск системы
+        System system(n, m, a, b);
+        system.run();
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Ошибка: " << e.what() << std::endl;
+        return 1;
+    }
 
     return 0;
 }
\ No newline at end of file
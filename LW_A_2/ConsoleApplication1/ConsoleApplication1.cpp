@@ -6,6 +6,13 @@
 #include <random>
 #include <string>
 #include <chrono>
+#include <sstream>
+
+#include "../../common/ResultCache.h"
+#include "../../common/Profiler.h"
+#ifdef LW_BENCHMARK
+#include "../../common/Benchmark.h"
+#endif
 
 using namespace std;
 
@@ -57,6 +64,7 @@ public:
     bool exchangeWith(Agent& other) {
         communicationRounds++;
         other.communicationRounds++;
+        LW_COUNT("simulation/exchange_calls");
 
         // Если текущий агент собрал все, он может отдавать безвозмездно
         if (targetCompleted) {
@@ -67,9 +75,11 @@ public:
                     // Безвозмездная передача
                     other.currentPatents.insert(patent);
                     other.checkTargetCompletion();
+                    LW_COUNT("simulation/gift_given");
                     return true;
                 }
             }
+            LW_COUNT("simulation/exchange_failed");
             return false;
         }
 
@@ -83,6 +93,7 @@ public:
                     currentPatents.insert(patent);
                     checkTargetCompletion();
                     successfulExchanges++;
+                    LW_COUNT("simulation/gift_received");
                     return true;
                 }
 
@@ -102,6 +113,7 @@ public:
 
                         successfulExchanges++;
                         other.successfulExchanges++;
+                        LW_COUNT("simulation/swap");
                         return true;
                     }
                 }
@@ -109,9 +121,21 @@ public:
             }
         }
 
+        LW_COUNT("simulation/exchange_failed");
         return false; // Обмен не состоялся
     }
 
+    // Участие в многостороннем обмене по циклу: отдать нужный соседу патент, получить свой
+    void givePatent(const string& patent) {
+        currentPatents.erase(patent);
+    }
+
+    void receivePatent(const string& patent) {
+        currentPatents.insert(patent);
+        successfulExchanges++;
+        checkTargetCompletion();
+    }
+
     // Геттеры
     int getId() const { return id; }
     int getCommunicationRounds() const { return communicationRounds; }
@@ -128,10 +152,19 @@ private:
     vector<Agent> agents;
     mt19937 rng;
     int totalCommunicationRounds;
+    long long totalAttempts;
+    int roundsPlayed;               // Раундов попарного общения
+    int cycleTrades;                // Многосторонних обменов по циклам
+    bool stalled;                   // Тупик: ни попарных обменов, ни циклов
 
 public:
     PatentSystem() : rng(chrono::steady_clock::now().time_since_epoch().count()),
-        totalCommunicationRounds(0) {
+        totalCommunicationRounds(0), totalAttempts(0), roundsPlayed(0), cycleTrades(0), stalled(false) {
+    }
+
+    // Детерминированная система с заданным зерном
+    explicit PatentSystem(unsigned seed) : rng(seed), totalCommunicationRounds(0), totalAttempts(0),
+        roundsPlayed(0), cycleTrades(0), stalled(false) {
     }
 
     // Генерация уникального ID патента
@@ -141,6 +174,7 @@ public:
 
     // Генерация начальных условий
     void generateInitialConditions(int numAgents, int targetSize, int initialSetSize) {
+        LW_PHASE("setup");
         agents.clear();
 
         // Шаг 1: Генерация целевых наборов для каждого агента
@@ -173,13 +207,14 @@ public:
         shuffle(allPatentsVec.begin(), allPatentsVec.end(), rng);
 
         // Раздача патентов агентам
-        int patentIndex = 0;
-        int patentsPerAgent = (allPatentsVec.size() < numAgents * initialSetSize) ?
-            allPatentsVec.size() / numAgents : initialSetSize;
+        size_t patentIndex = 0;
+        size_t agentCount = static_cast<size_t>(numAgents);
+        size_t patentsPerAgent = (allPatentsVec.size() < agentCount * initialSetSize) ?
+            allPatentsVec.size() / agentCount : static_cast<size_t>(initialSetSize);
 
         for (auto& agent : agents) {
             set<string> initialSet;
-            for (int j = 0; j < patentsPerAgent && patentIndex < allPatentsVec.size(); j++) {
+            for (size_t j = 0; j < patentsPerAgent && patentIndex < allPatentsVec.size(); j++) {
                 initialSet.insert(allPatentsVec[patentIndex++]);
             }
             agent.addInitialPatents(initialSet);
@@ -187,7 +222,7 @@ public:
 
         // Дополнительная раздача оставшихся патентов для баланса
         while (patentIndex < allPatentsVec.size()) {
-            int agentIndex = patentIndex % numAgents;
+            size_t agentIndex = patentIndex % agentCount;
             agents[agentIndex].addInitialPatents({ allPatentsVec[patentIndex++] });
         }
     }
@@ -203,13 +238,18 @@ public:
     }
 
     // Запуск симуляции
-    void runSimulation() {
+    void runSimulation(ostream& out = cout, int maxIterations = 10000) { // maxIterations - предохранитель от бесконечного цикла
+        LW_PHASE("simulation");
         totalCommunicationRounds = 0;
-        int maxIterations = 10000; // Предохранитель от бесконечного цикла
+        totalAttempts = 0;
+        roundsPlayed = 0;
+        cycleTrades = 0;
+        stalled = false;
 
         while (!isSimulationComplete() && maxIterations-- > 0) {
             // Перемешиваем агентов для случайного порядка общения
             shuffle(agents.begin(), agents.end(), rng);
+            int tradesBefore = totalCommunicationRounds;
 
             // Каждый агент пытается пообщаться с каждым другим агентом
             for (size_t i = 0; i < agents.size(); i++) {
@@ -219,33 +259,123 @@ public:
                     if (i == j) continue;
 
                     // Попытка обмена
+                    totalAttempts++;
                     bool exchanged = agents[i].exchangeWith(agents[j]);
                     if (exchanged) {
                         totalCommunicationRounds++;
                     }
                 }
             }
+            LW_HISTOGRAM("simulation/trades_per_round", totalCommunicationRounds - tradesBefore);
+            roundsPlayed++;
+
+            // Раунд без обменов ничего не изменил, и следующий прошёл бы так же:
+            // попарно больше обменяться нельзя, остаются только циклы
+            if (totalCommunicationRounds == tradesBefore && !isSimulationComplete()) {
+                int cycles = resolveTradingCycles();
+                if (cycles == 0) {
+                    stalled = true;
+                    break;
+                }
+                cycleTrades += cycles;
+                totalCommunicationRounds += cycles;
+            }
         }
 
-        if (maxIterations <= 0) {
-            cout << "Предупреждение: достигнуто максимальное количество итераций!" << endl;
+        if (stalled) {
+            out << "Тупик после " << roundsPlayed << " раундов: ни попарных обменов, ни циклов обмена нет" << endl;
+        }
+        else if (maxIterations <= 0) {
+            out << "Предупреждение: достигнуто максимальное количество итераций!" << endl;
         }
     }
 
+    // Многосторонние обмены в духе top trading cycles. Граф "хочет - имеет": каждый
+    // не собравший набор агент указывает на владельца первого недостающего патента.
+    // У каждой вершины одна исходящая дуга, поэтому обход по дугам всегда приходит
+    // в цикл; по каждому найденному циклу все участники одновременно получают свой
+    // патент от следующего. Цели агентов не пересекаются, так что отдаваемый патент
+    // отдающему не нужен. Возвращает число выполненных циклов (0 - циклов нет).
+    int resolveTradingCycles() {
+        LW_TIMER("simulation/trading_cycles");
+
+        // Владелец каждого патента
+        map<string, int> owner;
+        for (size_t i = 0; i < agents.size(); i++) {
+            for (const auto& patent : agents[i].getCurrentPatents()) {
+                owner[patent] = static_cast<int>(i);
+            }
+        }
+
+        // Дуга i -> владелец первого недостающего патента
+        vector<int> next(agents.size(), -1);
+        vector<string> wanted(agents.size());
+        for (size_t i = 0; i < agents.size(); i++) {
+            if (agents[i].isTargetCompleted()) continue;
+            for (const auto& patent : agents[i].getNeededPatents()) {
+                auto it = owner.find(patent);
+                if (it != owner.end()) {
+                    next[i] = it->second;
+                    wanted[i] = patent;
+                    break;
+                }
+            }
+        }
+
+        // Поиск циклов в функциональном графе: 0 - не посещена, 1 - на текущем пути, 2 - готова
+        vector<int> state(agents.size(), 0);
+        int cycles = 0;
+        for (size_t start = 0; start < agents.size(); start++) {
+            vector<int> path;
+            int v = static_cast<int>(start);
+            while (v >= 0 && state[v] == 0) {
+                state[v] = 1;
+                path.push_back(v);
+                v = next[v];
+            }
+
+            // Цикл, если путь замкнулся на себя
+            if (v >= 0 && state[v] == 1) {
+                auto first = find(path.begin(), path.end(), v);
+                vector<int> cycle(first, path.end());
+                for (int member : cycle) {
+                    agents[next[member]].givePatent(wanted[member]);
+                }
+                for (int member : cycle) {
+                    agents[member].receivePatent(wanted[member]);
+                }
+                cycles++;
+                LW_HISTOGRAM("simulation/cycle_length", cycle.size());
+            }
+            for (int u : path) {
+                state[u] = 2;
+            }
+        }
+        return cycles;
+    }
+
+    // Счётчики последнего прогона: состоявшиеся обмены и все попытки
+    int getTotalTrades() const { return totalCommunicationRounds; }
+    int getRoundsPlayed() const { return roundsPlayed; }
+    bool isStalled() const { return stalled; }
+    long long getTotalAttempts() const { return totalAttempts; }
+
     // Вывод результатов
-    void printResults() const {
-        cout << "\n=== РЕЗУЛЬТАТЫ СИМУЛЯЦИИ ===" << endl;
-        cout << "Всего агентов: " << agents.size() << endl;
-        cout << "Всего раундов общения в системе: " << totalCommunicationRounds << endl;
-        cout << "Все агенты собрали целевые наборы: "
+    void printResults(ostream& out = cout) const {
+        out << "\n=== РЕЗУЛЬТАТЫ СИМУЛЯЦИИ ===" << endl;
+        out << "Всего агентов: " << agents.size() << endl;
+        out << "Всего раундов общения в системе: " << totalCommunicationRounds << endl;
+        out << "Раундов попарного общения: " << roundsPlayed
+            << ", многосторонних обменов по циклам: " << cycleTrades << endl;
+        out << "Все агенты собрали целевые наборы: "
             << (isSimulationComplete() ? "Да" : "Нет") << endl << endl;
 
-        cout << "Детальная информация по агентам:" << endl;
-        cout << "ID | Размер целевого набора | Успешных обменов | Раундов общения" << endl;
-        cout << "---|------------------------|------------------|----------------" << endl;
+        out << "Детальная информация по агентам:" << endl;
+        out << "ID | Размер целевого набора | Успешных обменов | Раундов общения" << endl;
+        out << "---|------------------------|------------------|----------------" << endl;
 
         for (const auto& agent : agents) {
-            cout << agent.getId() << "  | "
+            out << agent.getId() << "  | "
                 << agent.getTargetSize() << "                    | "
                 << agent.getSuccessfulExchanges() << "                | "
                 << agent.getCommunicationRounds() << endl;
@@ -253,8 +383,8 @@ public:
     }
 
     // Дополнительная статистика
-    void printDetailedStatistics() const {
-        cout << "\n=== ДЕТАЛЬНАЯ СТАТИСТИКА ===" << endl;
+    void printDetailedStatistics(ostream& out = cout) const {
+        out << "\n=== ДЕТАЛЬНАЯ СТАТИСТИКА ===" << endl;
 
         int totalExchanges = 0;
         int totalRounds = 0;
@@ -266,43 +396,91 @@ public:
             if (agent.isTargetCompleted()) completedAgents++;
         }
 
-        cout << "Среднее количество обменов на агента: "
+        out << "Среднее количество обменов на агента: "
             << (double)totalExchanges / agents.size() << endl;
-        cout << "Среднее количество раундов на агента: "
+        out << "Среднее количество раундов на агента: "
             << (double)totalRounds / agents.size() << endl;
-        cout << "Агентов, собравших целевые наборы: "
+        out << "Агентов, собравших целевые наборы: "
             << completedAgents << " из " << agents.size() << endl;
     }
 };
 
-// Основная функция для демонстрации
-int main() {
-    setlocale(LC_ALL, "Russian");
-
-    PatentSystem system;
+// Демонстрационные сценарии; seed = 0 - случайные начальные условия
+void runScenarios(ostream& out, unsigned seed) {
+    PatentSystem system = seed ? PatentSystem(seed) : PatentSystem();
 
     // Параметры симуляции
     int numAgents = 10;         // Количество агентов
     int targetSize = 5;         // Размер целевого набора каждого агента
     int initialSetSize = 3;     // Примерный начальный размер набора
 
-    cout << "Генерация начальных условий..." << endl;
+    out << "Генерация начальных условий..." << endl;
     system.generateInitialConditions(numAgents, targetSize, initialSetSize);
 
-    cout << "Запуск симуляции..." << endl;
-    system.runSimulation();
+    out << "Запуск симуляции..." << endl;
+    system.runSimulation(out);
 
-    system.printResults();
-    system.printDetailedStatistics();
+    system.printResults(out);
+    system.printDetailedStatistics(out);
 
     // Пример дополнительной симуляции с другими параметрами
-    cout << "\n\n=== ДОПОЛНИТЕЛЬНАЯ СИМУЛЯЦИЯ ===" << endl;
-    cout << "Параметры: 20 агентов, целевой набор 7, начальный набор 4" << endl;
+    out << "\n\n=== ДОПОЛНИТЕЛЬНАЯ СИМУЛЯЦИЯ ===" << endl;
+    out << "Параметры: 20 агентов, целевой набор 7, начальный набор 4" << endl;
 
-    PatentSystem system2;
+    PatentSystem system2 = seed ? PatentSystem(seed + 1) : PatentSystem();
     system2.generateInitialConditions(20, 7, 4);
-    system2.runSimulation();
-    system2.printResults();
+    system2.runSimulation(out);
+    system2.printResults(out);
+}
+
+#ifdef LW_BENCHMARK
+// Эталонные замеры рынка патентов: фиксированное зерно, несколько масштабов.
+// Число итераций ограничено, чтобы зависшие рынки не растягивали замер. Имена
+// market_converge_*: рынок со сходящимся обменом несравним с прежними market_*
+void runBenchmarks(BenchmarkSuite& suite) {
+    struct Scale { int agents; int target; int initial; int iterations; };
+    for (Scale scale : { Scale{ 10, 5, 3, 2000 }, Scale{ 40, 7, 4, 200 }, Scale{ 150, 10, 6, 20 } }) {
+        string name = "market_converge_a" + to_string(scale.agents) + "_t" + to_string(scale.target);
+        suite.measure(name, "trades/s", [&] {
+            PatentSystem system(2024);
+            system.generateInitialConditions(scale.agents, scale.target, scale.initial);
+            ostringstream out;
+            system.runSimulation(out, scale.iterations);
+            return system.getTotalTrades();
+        });
+        suite.measure(name + "_attempts", "attempts/s", [&] {
+            PatentSystem system(2024);
+            system.generateInitialConditions(scale.agents, scale.target, scale.initial);
+            ostringstream out;
+            system.runSimulation(out, scale.iterations);
+            return system.getTotalAttempts();
+        });
+    }
+}
+#endif
+
+// Основная функция для демонстрации
+int main(int argc, char* argv[]) {
+    setlocale(LC_ALL, "Russian");
+#ifdef LW_BENCHMARK
+    return runBenchmarkMain(argc, argv, "lw_a_2", runBenchmarks);
+#endif
+
+    // С зерном в командной строке прогон детерминирован, и вывод берётся из кэша;
+    // зерно 0 означает случайные условия, такой прогон не кэшируется
+    unsigned seed = argc > 1 ? static_cast<unsigned>(stoul(argv[1])) : 0;
+    if (seed != 0) {
+        ResultCache cache;
+        string key = CacheKey("patents-2").add("scenario", "demo").add("seed", seed).str();
+        cout << cache.text(key, [&] {
+            ostringstream out;
+            runScenarios(out, seed);
+            return out.str();
+        });
+        return 0;
+    }
+
+    runScenarios(cout, 0);
 
     return 0;
-}
\ No newline at end of file
+}
@@ -1,13 +1,29 @@
 ﻿#include <iostream>
 #include <vector>
+#include <array>
 #include <cmath>
 #include <random>
 #include <algorithm>
 #include <fstream>
 #include <string>
-
-// Глобальный генератор случайных чисел
-std::mt19937 rng(std::random_device{}());
+#include <cstdint>
+#include <stdexcept>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <cstring>
+#include <limits>
+
+#include "../../common/ResultCache.h"
+#include "../../common/ColumnarFile.h"
+#include "../../common/Profiler.h"
+#ifdef LW_BENCHMARK
+#include "../../common/Benchmark.h"
+#endif
 
 // Структура для точки на корте
 struct Point {
@@ -32,10 +48,12 @@ public:
     Point position;
     double radius;
     double max_move;
+    double radius2;   // квадрат радиуса: проверка досягаемости без sqrt
+    double max_move2;
     bool is_agent;
 
     Player(double r, double l, bool agent = false)
-        : radius(r), max_move(l), is_agent(agent) {
+        : radius(r), max_move(l), radius2(r * r), max_move2(l * l), is_agent(agent) {
         // Начальная позиция в центре своей половины
         if (is_agent) {
             position = Point(0, 5); // Агент слева
@@ -47,17 +65,17 @@ public:
 
     // Может ли игрок отбить мяч в данной точке
     bool canReturn(const Point& ball) const {
-        double dist = distance(position, ball);
-        return dist <= radius;
+        return distance2(position, ball) <= radius2;
     }
 
     // Перемещение к мячу (но не дальше max_move)
     void moveToBall(const Point& ball) {
-        double dist = distance(position, ball);
-        if (dist <= max_move) {
+        double dist2 = distance2(position, ball);
+        if (dist2 <= max_move2) {
             position = ball;
         }
         else {
+            double dist = std::sqrt(dist2);
             double dx = ball.x - position.x;
             double dy = ball.y - position.y;
             position.x += (dx / dist) * max_move;
@@ -66,68 +84,93 @@ public:
     }
 
 private:
-    double distance(const Point& a, const Point& b) const {
-        return std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+    double distance2(const Point& a, const Point& b) const {
+        return (a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y);
     }
 };
 
-// Класс для моделирования теннисного матча
-class TennisSimulator {
-private:
-    // Параметры корта
-    const double COURT_WIDTH = 20.0;
-    const double COURT_HEIGHT = 10.0;
-    const double AGENT_HALF = 0.0;    // x ∈ [0, 10]
-    const double OPPONENT_HALF = 10.0; // x ∈ [10, 20]
+// Неизменяемая конфигурация корта для набора (r, l, n): геометрия квадратов,
+// соседи для ошибки удара, таблицы псевдонимов и квадраты радиусов.
+// Строится один раз и разделяется между потоками и матчами только для чтения.
+class CourtConfig {
+public:
+    static constexpr double COURT_WIDTH = 20.0;
+    static constexpr double COURT_HEIGHT = 10.0;
+    static constexpr double OPPONENT_HALF = 10.0;
+    static constexpr double ERROR_PROBABILITY = 0.05; // попадание в соседний квадрат или аут
+
+    // Ячейка таблицы псевдонимов: с вероятностью threshold - outcome, иначе alias
+    struct AliasCell {
+        double threshold;
+        int outcome;
+        int alias;
+    };
 
-    // Параметры игры
     double r;  // радиус действия болванчика
     double l;  // максимальное перемещение за удар
-    int n;     // количество квадратов (должно быть квадратом целого числа)
-    int grid_size; // размер сетки √n × √n
+    int n;     // количество квадратов
+    int grid_size;
 
-    // Игроки
-    Player agent;
-    Player opponent;
+    double agent_radius2;    // (2r)^2
+    double opponent_radius2; // r^2
+    double max_move2;        // l^2
 
-    // Сетка квадратов на половине корта болванчика
     std::vector<Square> squares;
-    std::vector<std::vector<int>> square_grid; // для нахождения соседей
+    std::vector<int> neighbour_begin; // соседи квадрата s: neighbours[neighbour_begin[s] .. neighbour_begin[s + 1])
+    std::vector<int> neighbours;
+    std::vector<int> alias_begin;     // таблица квадрата s: alias_cells[alias_begin[s] .. alias_begin[s + 1])
+    std::vector<AliasCell> alias_cells;
 
-    // Счёт
-    int agent_score;
-    int opponent_score;
-
-    // Генераторы случайных чисел
-    std::uniform_real_distribution<double> uniform_dist;
-    std::uniform_int_distribution<int> int_dist;
-
-public:
-    TennisSimulator(double r, double l, int n)
+    CourtConfig(double r, double l, int n)
         : r(r), l(l), n(n),
-        agent(2 * r, l, true),  // Агент имеет радиус 2r
-        opponent(r, l, false),
-        uniform_dist(0.0, 1.0),
-        int_dist(0, 100) {
+        agent_radius2(4 * r * r), opponent_radius2(r * r), max_move2(l * l) {
 
-        // Проверяем, что n - квадрат целого числа
-        grid_size = std::sqrt(n);
+        grid_size = static_cast<int>(std::sqrt(n));
         if (grid_size * grid_size != n) {
             throw std::invalid_argument("n должно быть квадратом целого числа");
         }
 
-        // Инициализация сетки квадратов
         initializeSquares();
+        initializeNeighbours();
+        initializeAliasTables();
+    }
 
-        // Начальные позиции
-        reset();
+    // Общая конфигурация для (r, l, n); повторные запросы не строят её заново.
+    // Перед построением новой записи реестр сбрасывает истёкшие: адаптивная сетка
+    // порождает новые (r, l) на каждом шаге, а weak_ptr от make_shared держит память
+    // всей конфигурации, пока жив сам
+    static std::shared_ptr<const CourtConfig> get(double r, double l, int n) {
+        static std::mutex mutex;
+        static std::map<std::tuple<double, double, int>, std::weak_ptr<const CourtConfig>> cache;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto key = std::make_tuple(r, l, n);
+        auto found = cache.find(key);
+        if (found != cache.end()) {
+            if (std::shared_ptr<const CourtConfig> config = found->second.lock()) {
+                return config;
+            }
+        }
+
+        std::erase_if(cache, [](const auto& entry) { return entry.second.expired(); });
+        std::shared_ptr<const CourtConfig> config = std::make_shared<const CourtConfig>(r, l, n);
+        cache[key] = config;
+        return config;
     }
 
-    // Инициализация квадратов на половине корта болванчика
-    void initializeSquares() {
-        squares.clear();
-        square_grid.assign(grid_size, std::vector<int>(grid_size, -1));
+    // Исход удара в квадрат target по одному равномерному u ∈ [0, 1):
+    // номер квадрата, куда попал мяч, или -1 (аут)
+    int sampleHit(int target, double u) const {
+        int begin = alias_begin[target];
+        int size = alias_begin[target + 1] - begin;
+        double scaled = u * size;
+        int k = std::min(static_cast<int>(scaled), size - 1);
+        const AliasCell& cell = alias_cells[begin + k];
+        return (scaled - k) < cell.threshold ? cell.outcome : cell.alias;
+    }
 
+private:
+    void initializeSquares() {
         double square_width = (COURT_WIDTH / 2) / grid_size;
         double square_height = COURT_HEIGHT / grid_size;
 
@@ -135,38 +178,135 @@ public:
         for (int i = 0; i < grid_size; ++i) {
             for (int j = 0; j < grid_size; ++j) {
                 double x_min = OPPONENT_HALF + i * square_width;
-                double x_max = x_min + square_width;
                 double y_min = j * square_height;
-                double y_max = y_min + square_height;
+                squares.emplace_back(id++, x_min, x_min + square_width, y_min, y_min + square_height);
+            }
+        }
+    }
 
-                squares.emplace_back(id, x_min, x_max, y_min, y_max);
-                square_grid[i][j] = id;
-                ++id;
+    void initializeNeighbours() {
+        // Направления ошибки: влево, вправо, вниз, вверх
+        const int directions[4][2] = { {-1, 0}, {1, 0}, {0, -1}, {0, 1} };
+        for (int s = 0; s < n; ++s) {
+            neighbour_begin.push_back(static_cast<int>(neighbours.size()));
+            int i = s / grid_size, j = s % grid_size;
+            for (const auto& dir : directions) {
+                int new_i = i + dir[0];
+                int new_j = j + dir[1];
+                if (new_i >= 0 && new_i < grid_size && new_j >= 0 && new_j < grid_size) {
+                    neighbours.push_back(new_i * grid_size + new_j);
+                }
             }
         }
+        neighbour_begin.push_back(static_cast<int>(neighbours.size()));
     }
 
-    // Сброс состояния для нового розыгрыша
-    void reset() {
-        agent.position = Point(5, 5); // Центр левой половины
-        opponent.position = Point(15, 5); // Центр правой половины
-        agent_score = 0;
-        opponent_score = 0;
+    // Метод Воуза: распределение исходов удара в каждый квадрат
+    void initializeAliasTables() {
+        for (int s = 0; s < n; ++s) {
+            alias_begin.push_back(static_cast<int>(alias_cells.size()));
+
+            std::vector<int> outcomes = { s };
+            std::vector<double> weights = { 1 - ERROR_PROBABILITY };
+            int count = neighbour_begin[s + 1] - neighbour_begin[s];
+            if (count == 0) {
+                outcomes.push_back(-1); // все направления ведут за пределы корта
+                weights.push_back(ERROR_PROBABILITY);
+            }
+            for (int k = 0; k < count; ++k) {
+                outcomes.push_back(neighbours[neighbour_begin[s] + k]);
+                weights.push_back(ERROR_PROBABILITY / count);
+            }
+
+            int size = static_cast<int>(outcomes.size());
+            std::vector<double> scaled(size);
+            std::vector<int> small, large;
+            for (int k = 0; k < size; ++k) {
+                scaled[k] = weights[k] * size;
+                (scaled[k] < 1.0 ? small : large).push_back(k);
+            }
+
+            std::vector<AliasCell> cells(size);
+            while (!small.empty() && !large.empty()) {
+                int less = small.back(); small.pop_back();
+                int more = large.back(); large.pop_back();
+                cells[less] = { scaled[less], outcomes[less], outcomes[more] };
+                scaled[more] -= 1.0 - scaled[less];
+                (scaled[more] < 1.0 ? small : large).push_back(more);
+            }
+            for (int k : large) cells[k] = { 1.0, outcomes[k], outcomes[k] };
+            for (int k : small) cells[k] = { 1.0, outcomes[k], outcomes[k] };
+
+            alias_cells.insert(alias_cells.end(), cells.begin(), cells.end());
+        }
+        alias_begin.push_back(static_cast<int>(alias_cells.size()));
     }
+};
 
-    // Алгоритм выбора квадрата для агента (стратегия)
-    int chooseSquare() {
-        // Стратегия: выбираем квадрат, наиболее удаленный от текущей позиции болванчика
-        // чтобы у него было меньше шансов добраться до мяча
+// Генератор splitmix64: 8 байт состояния и дешёвый перезапуск, что важно
+// для общих случайных чисел, когда генератор пересеивается на каждый матч
+struct SplitMix64 {
+    using result_type = std::uint64_t;
+
+    std::uint64_t state;
+
+    explicit SplitMix64(std::uint64_t seed = 0) : state(seed) {}
+
+    void seed(std::uint64_t value) { state = value; }
 
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return ~result_type(0); }
+
+    static std::uint64_t next(std::uint64_t& state) {
+        std::uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    result_type operator()() { return next(state); }
+};
+
+// Стратегии выбора квадрата для агента. Стратегия - параметр шаблона
+// TennisSimulator, поэтому её вызов встраивается без виртуальной диспетчеризации.
+// Интерфейс стратегии:
+//   static constexpr const char* name;
+//   int chooseSquare(const std::vector<Square>& squares, const Player& opponent, SplitMix64& rng);
+
+// Доля точек квадрата (сетка samples × samples), до которых игрок не дотянется
+double missFraction(const Square& square, const Point& position, double radius, int samples = 3) {
+    double radius2 = radius * radius;
+    double step_x = (square.x_max - square.x_min) / samples;
+    double step_y = (square.y_max - square.y_min) / samples;
+    int missed = 0;
+
+    for (int a = 0; a < samples; ++a) {
+        for (int b = 0; b < samples; ++b) {
+            double dx = square.x_min + (a + 0.5) * step_x - position.x;
+            double dy = square.y_min + (b + 0.5) * step_y - position.y;
+            if (dx * dx + dy * dy > radius2) {
+                ++missed;
+            }
+        }
+    }
+
+    return static_cast<double>(missed) / (samples * samples);
+}
+
+// Квадрат, наиболее удалённый от текущей позиции болванчика,
+// чтобы у него было меньше шансов добраться до мяча
+struct FarthestSquareStrategy {
+    static constexpr const char* name = "farthest";
+
+    int chooseSquare(const std::vector<Square>& squares, const Player& opponent, SplitMix64&) {
         int best_square = 0;
         double max_distance = -1;
 
         for (const auto& square : squares) {
-            double dist = distance(square.center, opponent.position);
+            double dx = square.center.x - opponent.position.x;
+            double dy = square.center.y - opponent.position.y;
+            double dist = std::sqrt(dx * dx + dy * dy);
 
-            // Учитываем, что болванчик может переместиться на расстояние l
-            // Выбираем квадрат, до которого болванчику нужно бежать дольше всего
             if (dist > max_distance) {
                 max_distance = dist;
                 best_square = square.id;
@@ -175,59 +315,216 @@ public:
 
         return best_square;
     }
+};
 
-    // Попадание мяча в квадрат с учетом погрешности
-    Point hitBallWithError(int target_square) {
-        double error_prob = uniform_dist(rng) * 100;
-
-        // С вероятностью 5% попадаем в соседний квадрат или аут
-        if (error_prob < 5) {
-            // Находим координаты квадрата в сетке
-            int i = -1, j = -1;
-            for (int idx = 0; idx < squares.size(); ++idx) {
-                if (squares[idx].id == target_square) {
-                    i = idx / grid_size;
-                    j = idx % grid_size;
-                    break;
-                }
-            }
+// Случайный квадрат (базовая линия для сравнения)
+struct RandomSquareStrategy {
+    static constexpr const char* name = "random";
 
-            // Список возможных направлений ошибки
-            std::vector<std::pair<int, int>> directions = {
-                {-1, 0}, {1, 0}, {0, -1}, {0, 1} // влево, вправо, вниз, вверх
-            };
+    int chooseSquare(const std::vector<Square>& squares, const Player&, SplitMix64& rng) {
+        std::uniform_int_distribution<int> square_dist(0, static_cast<int>(squares.size()) - 1);
+        return square_dist(rng);
+    }
+};
 
-            // Фильтруем допустимые направления
-            std::vector<std::pair<int, int>> valid_directions;
-            for (const auto& dir : directions) {
-                int new_i = i + dir.first;
-                int new_j = j + dir.second;
+// Квадрат с наибольшей долей площади вне радиуса болванчика;
+// при равенстве - наиболее удалённый
+struct ReachAwareStrategy {
+    static constexpr const char* name = "reach";
 
-                if (new_i >= 0 && new_i < grid_size && new_j >= 0 && new_j < grid_size) {
-                    valid_directions.push_back(dir);
-                }
+    int chooseSquare(const std::vector<Square>& squares, const Player& opponent, SplitMix64&) {
+        int best_square = 0;
+        double best_miss = -1;
+        double best_distance2 = -1;
+
+        for (const auto& square : squares) {
+            double miss = missFraction(square, opponent.position, opponent.radius);
+            double dx = square.center.x - opponent.position.x;
+            double dy = square.center.y - opponent.position.y;
+            double distance2 = dx * dx + dy * dy;
+
+            if (miss > best_miss || (miss == best_miss && distance2 > best_distance2)) {
+                best_miss = miss;
+                best_distance2 = distance2;
+                best_square = square.id;
             }
+        }
+
+        return best_square;
+    }
+};
+
+// Просмотр на удар вперёд: если болванчик отобьёт мяч, он сместится к квадрату
+// не дальше чем на l, и следующий удар агента будет из новой позиции
+struct LookaheadStrategy {
+    static constexpr const char* name = "lookahead";
+
+    // Вероятность, что агент отобьёт ответ болванчика. Отрицательное значение -
+    // оценить по геометрии корта при первом ходе (estimateAgentReturn)
+    double agent_return = -1.0;
+
+    // Болванчик отвечает в равномерную точку половины агента [0, 10] × [0, 10],
+    // агент достаёт мяч в радиусе 2r (см. TennisSimulator). Позиция агента стратегии
+    // не видна, поэтому берётся центр его половины - туда же он ставится перед розыгрышем
+    static double estimateAgentReturn(double opponent_radius) {
+        Square agent_half(-1, 0.0, 10.0, 0.0, 10.0);
+        return 1.0 - missFraction(agent_half, Point(5, 5), 2 * opponent_radius, 16);
+    }
 
-            // Если есть допустимые направления, выбираем случайное
-            if (!valid_directions.empty()) {
-                std::uniform_int_distribution<int> dir_dist(0, valid_directions.size() - 1);
-                auto dir = valid_directions[dir_dist(rng)];
-                int new_i = i + dir.first;
-                int new_j = j + dir.second;
+    int chooseSquare(const std::vector<Square>& squares, const Player& opponent, SplitMix64&) {
+        int best_square = 0;
+        double best_value = -1;
+        if (agent_return < 0) {
+            agent_return = estimateAgentReturn(opponent.radius);
+        }
 
-                // Возвращаем случайную точку в новом квадрате
-                const auto& new_square = squares[square_grid[new_i][new_j]];
-                return randomPointInSquare(new_square);
+        for (const auto& square : squares) {
+            double miss = missFraction(square, opponent.position, opponent.radius);
+
+            // Позиция болванчика после перемещения к квадрату
+            Point moved = opponent.position;
+            double dx = square.center.x - moved.x;
+            double dy = square.center.y - moved.y;
+            double dist = std::sqrt(dx * dx + dy * dy);
+            if (dist <= opponent.max_move) {
+                moved = square.center;
             }
             else {
-                // Если все направления ведут за пределы корта - аут
-                return Point(-1, -1); // Помечаем как аут
+                moved.x += dx / dist * opponent.max_move;
+                moved.y += dy / dist * opponent.max_move;
+            }
+
+            double next_miss = 0;
+            for (const auto& next : squares) {
+                next_miss = std::max(next_miss, missFraction(next, moved, opponent.radius));
+            }
+
+            double value = miss + (1 - miss) * agent_return * next_miss;
+            if (value > best_value) {
+                best_value = value;
+                best_square = square.id;
             }
         }
 
-        // С вероятностью 95% попадаем в выбранный квадрат
-        const auto& square = squares[target_square];
-        return randomPointInSquare(square);
+        return best_square;
+    }
+};
+
+// Табличная стратегия: половина болванчика x ∈ [10, 20], y ∈ [0, 10] разбита
+// на cells × cells клеток, для каждой клетки задан целевой квадрат
+struct TablePolicyStrategy {
+    static constexpr const char* name = "table";
+
+    int cells = 4;
+    std::vector<int> table; // table[i * cells + j] - квадрат для клетки (i, j)
+
+    int cellOf(const Point& p) const {
+        int i = static_cast<int>((p.x - 10.0) / 10.0 * cells);
+        int j = static_cast<int>(p.y / 10.0 * cells);
+        i = std::min(std::max(i, 0), cells - 1);
+        j = std::min(std::max(j, 0), cells - 1);
+        return i * cells + j;
+    }
+
+    int chooseSquare(const std::vector<Square>&, const Player& opponent, SplitMix64&) {
+        return table[cellOf(opponent.position)];
+    }
+};
+
+// Оценка вероятности с погрешностью
+struct WeightedEstimate {
+    double probability;
+    double std_error;
+    double relative_error; // std_error / probability
+    int matches;
+};
+
+// Класс для моделирования теннисного матча
+template <class Strategy = FarthestSquareStrategy>
+class TennisSimulator {
+private:
+    // Параметры корта
+    const double COURT_WIDTH = 20.0;
+    const double COURT_HEIGHT = 10.0;
+    const double AGENT_HALF = 0.0;    // x ∈ [0, 10]
+    const double OPPONENT_HALF = 10.0; // x ∈ [10, 20]
+
+    // Общая конфигурация (r, l, n): квадраты, соседи, таблицы ошибок удара
+    std::shared_ptr<const CourtConfig> config;
+
+    // Игроки
+    Player agent;
+    Player opponent;
+
+    // Счёт
+    int agent_score;
+    int opponent_score;
+
+    // Стратегия выбора квадрата
+    Strategy strategy;
+
+    // Генераторы случайных чисел: удары болванчика и удары агента разделены,
+    // чтобы при общих случайных числах разные стратегии видели одни и те же ответы
+    SplitMix64 court_rng;
+    SplitMix64 hit_rng;
+    std::uniform_real_distribution<double> uniform_dist;
+    std::uniform_int_distribution<int> int_dist;
+
+    // Выборка по значимости: доля ударов болванчика, смещённых в зону агента,
+    // и накопленный логарифм отношения правдоподобия текущего матча
+    double tilt = 0.0;
+    double log_weight = 0.0;
+
+public:
+    TennisSimulator(double r, double l, int n, std::uint64_t seed = std::random_device{}(),
+        Strategy strategy = Strategy())
+        : TennisSimulator(CourtConfig::get(r, l, n), seed, strategy) {
+    }
+
+    // Конструктор по готовой конфигурации: только инициализация игроков и генераторов
+    TennisSimulator(std::shared_ptr<const CourtConfig> court, std::uint64_t seed = std::random_device{}(),
+        Strategy strategy = Strategy())
+        : config(std::move(court)),
+        agent(2 * config->r, config->l, true),  // Агент имеет радиус 2r
+        opponent(config->r, config->l, false),
+        strategy(strategy),
+        uniform_dist(0.0, 1.0),
+        int_dist(0, 100) {
+
+        this->seed(seed);
+
+        // Начальные позиции
+        reset();
+    }
+
+    // Перезапуск генераторов случайных чисел
+    void seed(std::uint64_t value) {
+        SplitMix64 seeder(value);
+        court_rng.seed(seeder());
+        hit_rng.seed(seeder());
+    }
+
+    // Сброс состояния для нового розыгрыша
+    void reset() {
+        agent.position = Point(5, 5); // Центр левой половины
+        opponent.position = Point(15, 5); // Центр правой половины
+        agent_score = 0;
+        opponent_score = 0;
+    }
+
+    // Алгоритм выбора квадрата для агента (стратегия)
+    int chooseSquare() {
+        return strategy.chooseSquare(config->squares, opponent, hit_rng);
+    }
+
+    // Попадание мяча в квадрат с учетом погрешности: с вероятностью 95% в выбранный
+    // квадрат, иначе в соседний или аут. Исход - одна выборка из таблицы псевдонимов.
+    Point hitBallWithError(int target_square) {
+        int square = config->sampleHit(target_square, uniform_dist(hit_rng));
+        if (square < 0) {
+            return Point(-1, -1); // Помечаем как аут
+        }
+        return randomPointInSquare(config->squares[square]);
     }
 
     // Проверка, находится ли точка в пределах корта
@@ -244,11 +541,13 @@ public:
     bool simulateRally() {
         // Болванчик подает (случайная точка в половине агента)
         Point ball = randomPointInAgentHalf();
+        int strokes = 0;
 
         while (true) {
             // Агент пытается отбить
             if (agent.canReturn(ball)) {
                 agent.moveToBall(ball);
+                ++strokes;
 
                 // Агент выбирает квадрат и бьет
                 int target_square = chooseSquare();
@@ -256,21 +555,28 @@ public:
 
                 // Проверка на аут
                 if (!isInCourt(ball) || !isInOpponentHalf(ball)) {
+                    LW_COUNT("estimate/rally_lost_out");
+                    LW_HISTOGRAM("estimate/rally_strokes", strokes);
                     return false; // Агент проиграл розыгрыш
                 }
             }
             else {
+                LW_COUNT("estimate/rally_lost_unreached");
+                LW_HISTOGRAM("estimate/rally_strokes", strokes);
                 return false; // Агент не отбил
             }
 
             // Болванчик пытается отбить
             if (opponent.canReturn(ball)) {
                 opponent.moveToBall(ball);
+                ++strokes;
 
                 // Болванчик бьет в случайную точку половины агента
                 ball = randomPointInAgentHalf();
             }
             else {
+                LW_COUNT("estimate/rally_won");
+                LW_HISTOGRAM("estimate/rally_strokes", strokes);
                 return true; // Болванчик не отбил, агент выиграл
             }
         }
@@ -324,6 +630,7 @@ public:
 
     // Запуск множества матчей для оценки вероятности победы
     double estimateWinProbability(int num_matches = 1000) {
+        LW_PHASE("estimate");
         int wins = 0;
 
         for (int i = 0; i < num_matches; ++i) {
@@ -331,6 +638,7 @@ public:
             if (simulateMatch()) {
                 ++wins;
             }
+            LW_COUNT("estimate/matches");
 
             // Прогресс (опционально)
             if ((i + 1) % 100 == 0) {
@@ -341,6 +649,49 @@ public:
         return static_cast<double>(wins) / num_matches;
     }
 
+    // Оценка вероятности победы выборкой по значимости для редких побед агента.
+    // Подача и ответы болванчика с вероятностью tilt_fraction выбираются в квадрате
+    // досягаемости агента, иначе - равномерно по его половине; каждый матч
+    // взвешивается произведением отношений плотностей, поэтому оценка несмещённая
+    WeightedEstimate estimateWinProbabilityIS(int num_matches, double tilt_fraction) {
+        tilt = tilt_fraction;
+        double sum = 0, sum_sq = 0;
+
+        for (int i = 0; i < num_matches; ++i) {
+            reset();
+            log_weight = 0.0;
+            if (simulateMatch()) {
+                double weight = std::exp(log_weight);
+                sum += weight;
+                sum_sq += weight * weight;
+            }
+        }
+        tilt = 0.0;
+
+        WeightedEstimate result;
+        result.matches = num_matches;
+        result.probability = sum / num_matches;
+        double variance = (sum_sq / num_matches - result.probability * result.probability) /
+            std::max(1, num_matches - 1);
+        result.std_error = std::sqrt(std::max(variance, 0.0));
+        result.relative_error = result.probability > 0 ? result.std_error / result.probability : INFINITY;
+        return result;
+    }
+
+    // Оценка вероятности выиграть один розыгрыш (каждый с начальных позиций)
+    double estimateRallyWinProbability(int num_rallies = 10000) {
+        int won = 0;
+
+        for (int i = 0; i < num_rallies; ++i) {
+            reset();
+            if (simulateRally()) {
+                ++won;
+            }
+        }
+
+        return static_cast<double>(won) / num_rallies;
+    }
+
 private:
     // Вспомогательные функции
     double distance(const Point& a, const Point& b) const {
@@ -350,18 +701,1080 @@ private:
     Point randomPointInSquare(const Square& square) {
         std::uniform_real_distribution<double> x_dist(square.x_min, square.x_max);
         std::uniform_real_distribution<double> y_dist(square.y_min, square.y_max);
-        return Point(x_dist(rng), y_dist(rng));
+        return Point(x_dist(hit_rng), y_dist(hit_rng));
     }
 
     Point randomPointInAgentHalf() {
+        if (tilt > 0) {
+            return tiltedPointInAgentHalf();
+        }
         std::uniform_real_distribution<double> x_dist(0.0, OPPONENT_HALF);
         std::uniform_real_distribution<double> y_dist(0.0, COURT_HEIGHT);
-        return Point(x_dist(rng), y_dist(rng));
+        return Point(x_dist(court_rng), y_dist(court_rng));
+    }
+
+    // Смесь: с вероятностью tilt - точка в квадрате [x ± 2r] × [y ± 2r] вокруг агента
+    // (в пределах его половины), иначе - исходное равномерное распределение
+    Point tiltedPointInAgentHalf() {
+        double reach = agent.radius;
+        double x_lo = std::max(0.0, agent.position.x - reach);
+        double x_hi = std::min(OPPONENT_HALF, agent.position.x + reach);
+        double y_lo = std::max(0.0, agent.position.y - reach);
+        double y_hi = std::min(COURT_HEIGHT, agent.position.y + reach);
+        double box_area = (x_hi - x_lo) * (y_hi - y_lo);
+        double half_area = OPPONENT_HALF * COURT_HEIGHT;
+
+        Point p;
+        if (uniform_dist(court_rng) < tilt) {
+            p = Point(x_lo + uniform_dist(court_rng) * (x_hi - x_lo),
+                y_lo + uniform_dist(court_rng) * (y_hi - y_lo));
+        }
+        else {
+            p = Point(uniform_dist(court_rng) * OPPONENT_HALF, uniform_dist(court_rng) * COURT_HEIGHT);
+        }
+
+        bool inside = p.x >= x_lo && p.x <= x_hi && p.y >= y_lo && p.y <= y_hi;
+        double proposal = (1 - tilt) / half_area + (inside ? tilt / box_area : 0.0);
+        log_weight += std::log((1.0 / half_area) / proposal);
+        return p;
+    }
+};
+
+// Пакетный симулятор: K матчей одновременно в виде структуры массивов (SoA).
+// Все матчи продвигаются синхронно по одному удару за шаг, ветвления по игрокам
+// заменены масками, чтобы циклы по матчам векторизовались компилятором.
+// Правила (розыгрыш, гейм, матч) те же, что и в TennisSimulator.
+class BatchTennisSimulator {
+private:
+    // Параметры корта
+    static constexpr double COURT_HEIGHT = CourtConfig::COURT_HEIGHT;
+    static constexpr double OPPONENT_HALF = CourtConfig::OPPONENT_HALF;
+
+    // Общая конфигурация (r, l, n)
+    std::shared_ptr<const CourtConfig> config;
+
+    // Параметры игры (копии из конфигурации для горячих циклов)
+    double agent_radius2;    // (2r)^2 - квадрат радиуса агента
+    double opponent_radius2; // r^2 - квадрат радиуса болванчика
+    double l;                // максимальное перемещение за удар
+    int n;                   // количество квадратов
+    int grid_size;           // размер сетки √n × √n
+    int K;                   // количество одновременно моделируемых матчей
+
+    // Геометрия квадратов
+    double square_width, square_height;
+    std::vector<double> square_x_min, square_y_min;
+    std::vector<double> square_cx, square_cy;
+
+    // Состояние матчей (по одному элементу на матч)
+    std::vector<double> agent_x, agent_y;
+    std::vector<double> opponent_x, opponent_y;
+    std::vector<double> ball_x, ball_y;
+    std::vector<double> best_distance2;
+    std::vector<int> target_square;
+    std::vector<unsigned char> opponent_turn; // 0 - бьёт агент, 1 - бьёт болванчик
+    std::vector<unsigned char> returned;      // отбит ли мяч на текущем шаге
+    std::vector<unsigned char> active;        // маска незавершённых матчей
+    std::vector<int> agent_points, opponent_points;
+    std::vector<int> agent_sets, opponent_sets;
+    std::vector<uint64_t> rng_state;
+
+    // Учёт матчей
+    int matches_to_play;
+    int matches_started;
+    int active_count;
+    int wins;
+
+public:
+    BatchTennisSimulator(double r, double l, int n, int K, uint64_t seed = std::random_device{}())
+        : config(CourtConfig::get(r, l, n)),
+        agent_radius2(config->agent_radius2), opponent_radius2(config->opponent_radius2),
+        l(config->l), n(config->n), grid_size(config->grid_size), K(K),
+        matches_to_play(0), matches_started(0), active_count(0), wins(0) {
+
+        if (K <= 0) {
+            throw std::invalid_argument("K должно быть положительным");
+        }
+
+        initializeSquares();
+
+        agent_x.resize(K); agent_y.resize(K);
+        opponent_x.resize(K); opponent_y.resize(K);
+        ball_x.resize(K); ball_y.resize(K);
+        best_distance2.resize(K);
+        target_square.resize(K);
+        opponent_turn.resize(K);
+        returned.resize(K);
+        active.resize(K);
+        agent_points.resize(K); opponent_points.resize(K);
+        agent_sets.resize(K); opponent_sets.resize(K);
+
+        // Независимый поток случайных чисел для каждого матча
+        rng_state.resize(K);
+        uint64_t seeder = seed;
+        for (int i = 0; i < K; ++i) {
+            rng_state[i] = SplitMix64::next(seeder);
+        }
+    }
+
+    // Оценка вероятности победы агента по num_matches матчам
+    double estimateWinProbability(int num_matches = 1000) {
+        matches_to_play = num_matches;
+        matches_started = 0;
+        active_count = 0;
+        wins = 0;
+
+        for (int i = 0; i < K; ++i) {
+            startMatch(i);
+        }
+
+        while (active_count > 0) {
+            step();
+        }
+
+        return static_cast<double>(wins) / num_matches;
+    }
+
+private:
+    // Геометрия квадратов в виде отдельных массивов
+    void initializeSquares() {
+        square_width = config->squares[0].x_max - config->squares[0].x_min;
+        square_height = config->squares[0].y_max - config->squares[0].y_min;
+
+        for (const auto& square : config->squares) {
+            square_x_min.push_back(square.x_min);
+            square_y_min.push_back(square.y_min);
+            square_cx.push_back(square.center.x);
+            square_cy.push_back(square.center.y);
+        }
+    }
+
+    // Равномерное число в [0, 1) из старших 53 бит SplitMix64::next;
+    // state - поток матча из rng_state
+    static double nextUniform(uint64_t& state) {
+        return (SplitMix64::next(state) >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    // Начать новый матч в ячейке i или выключить её, если матчи закончились
+    void startMatch(int i) {
+        if (matches_started >= matches_to_play) {
+            if (active[i]) {
+                active[i] = 0;
+                --active_count;
+            }
+            return;
+        }
+        if (!active[i]) {
+            active[i] = 1;
+            ++active_count;
+        }
+        ++matches_started;
+
+        agent_points[i] = opponent_points[i] = 0;
+        agent_sets[i] = opponent_sets[i] = 0;
+        resetPositions(i);
+        serve(i);
+    }
+
+    void resetPositions(int i) {
+        agent_x[i] = 5; agent_y[i] = 5;
+        opponent_x[i] = 15; opponent_y[i] = 5;
+    }
+
+    // Болванчик подаёт (или отвечает) в случайную точку половины агента
+    void serve(int i) {
+        ball_x[i] = nextUniform(rng_state[i]) * OPPONENT_HALF;
+        ball_y[i] = nextUniform(rng_state[i]) * COURT_HEIGHT;
+        opponent_turn[i] = 0;
+    }
+
+    // Один удар во всех активных матчах
+    void step() {
+        // 1. Отбивающий игрок проверяет досягаемость мяча и перемещается к нему
+        for (int i = 0; i < K; ++i) {
+            const bool opp = opponent_turn[i] != 0;
+            const double hx = opp ? opponent_x[i] : agent_x[i];
+            const double hy = opp ? opponent_y[i] : agent_y[i];
+            const double dx = ball_x[i] - hx;
+            const double dy = ball_y[i] - hy;
+            const double d2 = dx * dx + dy * dy;
+            const bool can = active[i] && d2 <= (opp ? opponent_radius2 : agent_radius2);
+
+            const double dist = std::sqrt(d2);
+            const bool reach = dist <= l;
+            const double mx = reach ? ball_x[i] : hx + (dx / dist) * l;
+            const double my = reach ? ball_y[i] : hy + (dy / dist) * l;
+
+            agent_x[i] = (can && !opp) ? mx : agent_x[i];
+            agent_y[i] = (can && !opp) ? my : agent_y[i];
+            opponent_x[i] = (can && opp) ? mx : opponent_x[i];
+            opponent_y[i] = (can && opp) ? my : opponent_y[i];
+            returned[i] = can;
+        }
+
+        // 2. Выбор квадрата, наиболее удалённого от болванчика (как в chooseSquare).
+        // Максимум расстояния до центров достигается в угловом квадрате, поэтому
+        // достаточно перебрать четыре угла в порядке возрастания id.
+        const int corners[4] = { 0, grid_size - 1, n - grid_size, n - 1 };
+        std::fill(best_distance2.begin(), best_distance2.end(), -1.0);
+        std::fill(target_square.begin(), target_square.end(), 0);
+        for (int s : corners) {
+            const double cx = square_cx[s];
+            const double cy = square_cy[s];
+            for (int i = 0; i < K; ++i) {
+                const double dx = cx - opponent_x[i];
+                const double dy = cy - opponent_y[i];
+                const double d2 = dx * dx + dy * dy;
+                const bool better = d2 > best_distance2[i];
+                best_distance2[i] = better ? d2 : best_distance2[i];
+                target_square[i] = better ? s : target_square[i];
+            }
+        }
+
+        // 3. Удары и подсчёт очков (редкие ветвления, скалярно)
+        for (int i = 0; i < K; ++i) {
+            if (!active[i]) continue;
+
+            if (!returned[i]) {
+                // Не отбил агент - очко болванчику, не отбил болванчик - очко агенту
+                finishRally(i, opponent_turn[i] != 0);
+                continue;
+            }
+
+            if (opponent_turn[i]) {
+                serve(i);
+                continue;
+            }
+
+            int square = config->sampleHit(target_square[i], nextUniform(rng_state[i]));
+            if (square < 0) {
+                finishRally(i, false); // аут
+                continue;
+            }
+
+            ball_x[i] = square_x_min[square] + nextUniform(rng_state[i]) * square_width;
+            ball_y[i] = square_y_min[square] + nextUniform(rng_state[i]) * square_height;
+            opponent_turn[i] = 1;
+        }
+    }
+
+    // Завершение розыгрыша: счёт гейма, сета и матча
+    void finishRally(int i, bool agent_won) {
+        if (agent_won) {
+            ++agent_points[i];
+        }
+        else {
+            ++opponent_points[i];
+        }
+
+        bool agent_game = agent_points[i] >= 4 && agent_points[i] - opponent_points[i] >= 2;
+        bool opponent_game = opponent_points[i] >= 4 && opponent_points[i] - agent_points[i] >= 2;
+
+        if (agent_game || opponent_game) {
+            // Позиции между геймами не сбрасываются, как в simulateGame
+            agent_points[i] = opponent_points[i] = 0;
+            if (agent_game) {
+                ++agent_sets[i];
+            }
+            else {
+                ++opponent_sets[i];
+            }
+
+            if (agent_sets[i] == 2 || opponent_sets[i] == 2) {
+                if (agent_sets[i] == 2) {
+                    ++wins;
+                }
+                startMatch(i);
+                return;
+            }
+        }
+        else {
+            resetPositions(i);
+        }
+
+        serve(i);
     }
 };
 
+// Точный расчёт вероятности победы по цепочке Маркова счёта.
+// Розыгрыши считаются независимыми с вероятностью p выигрыша агентом,
+// тогда гейм и матч - поглощающие цепочки над счётом, и моделировать
+// нужно только P(розыгрыш).
+class ScoreMarkovChain {
+public:
+    // Вероятность выиграть гейм (до 4 очков с разницей в 2)
+    static double gameWinProbability(double p) {
+        double q = 1 - p;
+
+        // "Ровно" (3:3 и далее): выигрыш двух очков подряд раньше проигрыша двух
+        double deuce = (p * p + q * q > 0) ? p * p / (p * p + q * q) : 0.0;
+
+        // Динамика по счёту от 3:3 к 0:0
+        double win[5][5] = {};
+        for (int a = 4; a >= 0; --a) {
+            for (int o = 4; o >= 0; --o) {
+                if (a >= 4 && a - o >= 2) {
+                    win[a][o] = 1.0;
+                }
+                else if (o >= 4 && o - a >= 2) {
+                    win[a][o] = 0.0;
+                }
+                else if (a >= 3 && o >= 3) {
+                    // 3:3, 4:3, 3:4 сводятся к состоянию "ровно"
+                    if (a == o) {
+                        win[a][o] = deuce;
+                    }
+                    else if (a > o) {
+                        win[a][o] = p + q * deuce;
+                    }
+                    else {
+                        win[a][o] = p * deuce;
+                    }
+                }
+                else {
+                    win[a][o] = p * win[a + 1][o] + q * win[a][o + 1];
+                }
+            }
+        }
+        return win[0][0];
+    }
+
+    // Вероятность выиграть матч до 2 выигранных геймов
+    static double matchWinProbability(double g) {
+        return g * g * (3 - 2 * g);
+    }
+
+    // Вероятность выиграть матч по вероятности выиграть розыгрыш
+    static double matchWinProbabilityFromRally(double p) {
+        return matchWinProbability(gameWinProbability(p));
+    }
+
+    // Производная P(матч) по p (численно) для оценки погрешности дельта-методом
+    static double matchWinDerivative(double p) {
+        double h = 1e-6;
+        double lo = std::max(0.0, p - h);
+        double hi = std::min(1.0, p + h);
+        return (matchWinProbabilityFromRally(hi) - matchWinProbabilityFromRally(lo)) / (hi - lo);
+    }
+};
+
+// Результат аналитической оценки
+struct ExactEstimate {
+    double rally_probability;  // оценка P(розыгрыш)
+    double match_probability;  // P(матч) по цепочке Маркова
+    double match_variance;     // дисперсия исхода одного матча P(1 - P)
+    double estimator_variance; // дисперсия оценки P(матч) (дельта-метод)
+};
+
+// Оценка P(матч): моделируем только розыгрыши, дальше - цепочка Маркова
+ExactEstimate solveWinProbability(double r, double l, int n, int num_rallies = 20000) {
+    TennisSimulator simulator(r, l, n);
+    double p = simulator.estimateRallyWinProbability(num_rallies);
+    double match = ScoreMarkovChain::matchWinProbabilityFromRally(p);
+    double derivative = ScoreMarkovChain::matchWinDerivative(p);
+
+    ExactEstimate result;
+    result.rally_probability = p;
+    result.match_probability = match;
+    result.match_variance = match * (1 - match);
+    result.estimator_variance = derivative * derivative * p * (1 - p) / num_rallies;
+    return result;
+}
+
+// Результат стратегии в турнире
+struct TournamentEntry {
+    std::string name;
+    std::vector<unsigned char> outcomes; // исход каждого матча (1 - победа агента)
+    double win_probability = 0;
+};
+
+// Матчи одной стратегии; матч i всегда играется с зерном base_seed + i,
+// поэтому все стратегии видят одни и те же случайные числа
+template <class Strategy>
+TournamentEntry playStrategy(double r, double l, int n, int num_matches, std::uint32_t base_seed) {
+    TennisSimulator<Strategy> simulator(r, l, n, base_seed);
+    TournamentEntry entry;
+    entry.name = Strategy::name;
+    entry.outcomes.resize(num_matches);
+
+    int wins = 0;
+    for (int i = 0; i < num_matches; ++i) {
+        simulator.seed(base_seed + i);
+        simulator.reset();
+        entry.outcomes[i] = simulator.simulateMatch();
+        wins += entry.outcomes[i];
+    }
+
+    entry.win_probability = static_cast<double>(wins) / num_matches;
+    return entry;
+}
+
+// Турнир стратегий: каждая стратегия в своём потоке, результат упорядочен по убыванию
+template <class... Strategies>
+std::vector<TournamentEntry> runTournament(double r, double l, int n, int num_matches, std::uint32_t base_seed) {
+    std::vector<TournamentEntry> entries(sizeof...(Strategies));
+
+    // Потоки создаются сразу в массиве: элементы списка инициализации вычисляются
+    // слева направо, так что index++ нумерует стратегии по порядку
+    int index = 0;
+    std::array<std::thread, sizeof...(Strategies)> threads = {
+        std::thread([&entries, i = index++, r, l, n, num_matches, base_seed] {
+            entries[i] = playStrategy<Strategies>(r, l, n, num_matches, base_seed);
+        })...
+    };
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::stable_sort(entries.begin(), entries.end(), [](const TournamentEntry& a, const TournamentEntry& b) {
+        return a.win_probability > b.win_probability;
+    });
+    return entries;
+}
+
+// Вывод рейтинга: разность с лидером и её погрешность по парным исходам
+void printTournament(const std::vector<TournamentEntry>& entries) {
+    const auto& leader = entries.front();
+    int num_matches = static_cast<int>(leader.outcomes.size());
+
+    std::cout << "rank,strategy,win_prob,stderr,diff_to_leader,paired_stderr,independent_stderr\n";
+    for (size_t k = 0; k < entries.size(); ++k) {
+        const auto& entry = entries[k];
+        double p = entry.win_probability;
+
+        // Парная разность (общие случайные числа) против независимых выборок
+        double mean_diff = leader.win_probability - p;
+        double sum_sq = 0;
+        for (int i = 0; i < num_matches; ++i) {
+            double d = static_cast<double>(leader.outcomes[i]) - entry.outcomes[i] - mean_diff;
+            sum_sq += d * d;
+        }
+        double paired = num_matches > 1 ? std::sqrt(sum_sq / (num_matches - 1) / num_matches) : 0.0;
+        double independent = std::sqrt((leader.win_probability * (1 - leader.win_probability) +
+            p * (1 - p)) / num_matches);
+
+        std::cout << k + 1 << "," << entry.name << "," << p << ","
+            << std::sqrt(p * (1 - p) / num_matches) << "," << mean_diff << ","
+            << paired << "," << independent << std::endl;
+    }
+}
+
+// Поиск табличной стратегии методом перекрёстной энтропии.
+// Кандидаты оцениваются по вероятности выиграть розыгрыш (P(матч) монотонна по ней)
+// на общих случайных числах: розыгрыш i у всех кандидатов играется с зерном base_seed + i.
+// Оценка идёт этапами; кандидат, парно значимо худший лидера этапа, выбывает досрочно.
+class PolicyOptimizer {
+public:
+    struct Result {
+        std::vector<int> table;
+        int cells;
+        double rally_probability;
+        double match_probability;
+        double heuristic_rally_probability;
+        long long rallies_simulated;
+    };
+
+    int cells = 4;              // разбиение половины болванчика
+    int population = 30;        // кандидатов на итерации
+    int iterations = 12;
+    double elite_fraction = 0.2;
+    double smoothing = 0.7;     // вес новой оценки распределения
+    int stage_rallies = 500;    // розыгрышей на этап гонки
+    int max_stages = 8;
+    double drop_z = 3.0;        // порог досрочного отсева
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+
+    PolicyOptimizer(double r, double l, int n, std::uint32_t seed = 2024)
+        : r(r), l(l), n(n), rng(seed) {
+    }
+
+    Result optimize() {
+        const int num_cells = cells * cells;
+        rallies_simulated = 0;
+
+        // Распределение квадратов для каждой клетки, начально равномерное
+        std::vector<std::vector<double>> probabilities(num_cells, std::vector<double>(n, 1.0 / n));
+
+        std::vector<int> best_table;
+        double best_estimate = -1;
+
+        for (int iteration = 0; iteration < iterations; ++iteration) {
+            std::vector<Candidate> candidates(population);
+            for (auto& candidate : candidates) {
+                candidate.table.resize(num_cells);
+                for (int c = 0; c < num_cells; ++c) {
+                    std::discrete_distribution<int> square_dist(probabilities[c].begin(), probabilities[c].end());
+                    candidate.table[c] = square_dist(rng);
+                }
+            }
+            // Лучший найденный кандидат участвует снова, чтобы его не потерять
+            if (!best_table.empty()) {
+                candidates[0].table = best_table;
+            }
+
+            race(candidates, 1000003u * (iteration + 1));
+
+            std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+                if (a.alive != b.alive) return a.alive > b.alive;
+                return a.mean() > b.mean();
+            });
+
+            if (candidates.front().mean() > best_estimate || candidates.front().table == best_table) {
+                best_estimate = candidates.front().mean();
+                best_table = candidates.front().table;
+            }
+
+            // Обновление распределения по элите
+            int elite = std::max(1, static_cast<int>(population * elite_fraction));
+            for (int c = 0; c < num_cells; ++c) {
+                std::vector<double> counts(n, 0.0);
+                for (int k = 0; k < elite; ++k) {
+                    counts[candidates[k].table[c]] += 1.0 / elite;
+                }
+                for (int s = 0; s < n; ++s) {
+                    probabilities[c][s] = smoothing * counts[s] + (1 - smoothing) * probabilities[c][s];
+                }
+            }
+        }
+
+        // Итоговая оценка на свежих случайных числах, чтобы избежать смещения отбора
+        const int final_rallies = stage_rallies * max_stages * 4;
+        TablePolicyStrategy policy;
+        policy.cells = cells;
+        policy.table = best_table;
+
+        Result result;
+        result.table = best_table;
+        result.cells = cells;
+        result.rally_probability = rallyProbability(policy, final_rallies, 777777u);
+        result.match_probability = ScoreMarkovChain::matchWinProbabilityFromRally(result.rally_probability);
+        result.heuristic_rally_probability = rallyProbability(FarthestSquareStrategy(), final_rallies, 777777u);
+        result.rallies_simulated = rallies_simulated;
+        return result;
+    }
+
+private:
+    struct Candidate {
+        std::vector<int> table;
+        std::vector<unsigned char> outcomes;
+        bool alive = true;
+
+        double mean() const {
+            if (outcomes.empty()) return 0.0;
+            int won = 0;
+            for (unsigned char o : outcomes) won += o;
+            return static_cast<double>(won) / outcomes.size();
+        }
+    };
+
+    double r, l;
+    int n;
+    std::mt19937 rng;
+    std::atomic<long long> rallies_simulated{ 0 };
+
+    // Розыгрыши [first, first + count) с зернами base_seed + i
+    template <class Strategy>
+    void playRallies(const Strategy& strategy, std::uint32_t base_seed, int first, int count,
+        std::vector<unsigned char>& outcomes) {
+        TennisSimulator<Strategy> simulator(r, l, n, base_seed, strategy);
+        for (int i = first; i < first + count; ++i) {
+            simulator.seed(base_seed + i);
+            simulator.reset();
+            outcomes.push_back(simulator.simulateRally());
+        }
+        rallies_simulated += count;
+    }
+
+    template <class Strategy>
+    double rallyProbability(const Strategy& strategy, int count, std::uint32_t base_seed) {
+        std::vector<unsigned char> outcomes;
+        playRallies(strategy, base_seed, 0, count, outcomes);
+        int won = 0;
+        for (unsigned char o : outcomes) won += o;
+        return static_cast<double>(won) / count;
+    }
+
+    // Гонка: этапы параллельной оценки с отсевом парно худших кандидатов
+    void race(std::vector<Candidate>& candidates, std::uint32_t base_seed) {
+        for (int stage = 0; stage < max_stages; ++stage) {
+            std::vector<Candidate*> alive;
+            for (auto& candidate : candidates) {
+                if (candidate.alive) alive.push_back(&candidate);
+            }
+            if (alive.size() <= 1) break;
+
+            std::atomic<size_t> next{ 0 };
+            auto worker = [&] {
+                for (size_t k = next++; k < alive.size(); k = next++) {
+                    TablePolicyStrategy policy;
+                    policy.cells = cells;
+                    policy.table = alive[k]->table;
+                    playRallies(policy, base_seed, stage * stage_rallies, stage_rallies, alive[k]->outcomes);
+                }
+            };
+            std::vector<std::thread> pool;
+            for (int t = 0; t < threads; ++t) pool.emplace_back(worker);
+            for (auto& thread : pool) thread.join();
+
+            // Лидер этапа и парные разности с ним
+            Candidate* leader = *std::max_element(alive.begin(), alive.end(),
+                [](const Candidate* a, const Candidate* b) { return a->mean() < b->mean(); });
+            size_t count = leader->outcomes.size();
+            for (Candidate* candidate : alive) {
+                if (candidate == leader) continue;
+                double sum = 0, sum_sq = 0;
+                for (size_t i = 0; i < count; ++i) {
+                    double d = static_cast<double>(leader->outcomes[i]) - candidate->outcomes[i];
+                    sum += d;
+                    sum_sq += d * d;
+                }
+                double mean = sum / count;
+                double variance = (sum_sq - count * mean * mean) / (count - 1);
+                double se = std::sqrt(std::max(variance, 0.0) / count);
+                if (mean > drop_z * se && se > 0) {
+                    candidate->alive = false;
+                }
+            }
+        }
+    }
+};
+
+// Поиск оптимальной табличной стратегии и вывод таблицы
+void runPolicyOptimization(double r, double l, int n) {
+    PolicyOptimizer optimizer(r, l, n);
+    auto start = std::chrono::steady_clock::now();
+    PolicyOptimizer::Result result = optimizer.optimize();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Оптимизация стратегии: r=" << r << ", l=" << l << ", n=" << n << "\n";
+    std::cout << "Таблица (строки - клетки по x от сетки к задней линии, столбцы - по y):\n";
+    for (int i = 0; i < result.cells; ++i) {
+        for (int j = 0; j < result.cells; ++j) {
+            std::cout << result.table[i * result.cells + j] << (j + 1 < result.cells ? "," : "\n");
+        }
+    }
+    std::cout << "P(розыгрыш) = " << result.rally_probability
+        << " (эвристика farthest: " << result.heuristic_rally_probability << ")\n";
+    std::cout << "P(матч) = " << result.match_probability
+        << " (эвристика farthest: "
+        << ScoreMarkovChain::matchWinProbabilityFromRally(result.heuristic_rally_probability) << ")\n";
+    std::cout << "Розыгрышей смоделировано: " << result.rallies_simulated
+        << ", время: " << seconds << " с\n";
+}
+
+// Версия модели в ключах кэша: менять при изменении правил или генераторов
+const char* const TENNIS_MODEL_VERSION = "tennis-6";
+
+// Зерно точки (r, l, n), не зависящее от платформы
+std::uint64_t pointSeed(std::uint64_t seed, double r, double l, int n) {
+    std::uint64_t bits[2];
+    std::memcpy(&bits[0], &r, sizeof(double));
+    std::memcpy(&bits[1], &l, sizeof(double));
+    std::uint64_t state = seed ^ static_cast<std::uint64_t>(n);
+    state = SplitMix64::next(state) ^ bits[0];
+    state = SplitMix64::next(state) ^ bits[1];
+    return SplitMix64::next(state);
+}
+
+// Матчи [first, first + count) точки (r, l, n): зерно зависит от first,
+// поэтому дозапуск продолжает выборку, а не повторяет её. Симулятор считает матчи
+// в int, поэтому дозапуск больше INT_MAX играется частями, каждая со своим first
+long long playMatches(double r, double l, int n, std::uint64_t seed, long long first, long long count) {
+    long long wins = 0;
+    while (count > 0) {
+        int chunk = static_cast<int>(std::min<long long>(count, std::numeric_limits<int>::max()));
+        TennisSimulator simulator(r, l, n, pointSeed(seed, r, l, n) + static_cast<std::uint64_t>(first));
+        wins += std::llround(simulator.estimateWinProbability(chunk) * chunk);
+        first += chunk;
+        count -= chunk;
+    }
+    return wins;
+}
+
+// Не меньше num_matches матчей точки с учётом кэша (cache может быть nullptr);
+// в *simulated добавляется число матчей, сыгранных на самом деле (без взятых из кэша)
+CacheRecord cachedMatches(ResultCache* cache, double r, double l, int n, std::uint64_t seed,
+    long long num_matches, CacheRecord known = CacheRecord(), long long* simulated = nullptr) {
+    auto compute = [&](long long first, long long count) {
+        if (simulated) {
+            *simulated += count;
+        }
+        return playMatches(r, l, n, seed, first, count);
+    };
+
+    if (!cache) {
+        if (known.trials < num_matches) {
+            long long count = num_matches - known.trials;
+            known.successes += compute(known.trials, count);
+            known.trials += count;
+        }
+        return known;
+    }
+
+    std::string key = CacheKey(TENNIS_MODEL_VERSION)
+        .add("r", r).add("l", l).add("n", n).add("seed", seed).str();
+    return cache->extend(key, num_matches, compute);
+}
+
+// Адаптивный свип по (r, l) при фиксированном n. Начинается с грубой сетки
+// и делит клетки, в которых поверхность P(победы) меняется больше допуска;
+// точки, погрешность которых больше допуска, досчитываются (выборка не теряется).
+// Результат - нерегулярный набор точек на иерархической сетке.
+class AdaptiveSweep {
+public:
+    struct SamplePoint {
+        double r = 0, l = 0;
+        int level = 0;      // уровень сетки, на котором появилась точка
+        long long wins = 0;
+        long long matches = 0;
+
+        double probability() const {
+            return matches > 0 ? static_cast<double>(wins) / matches : 0.0;
+        }
+
+        // Погрешность со сглаживанием (wins + 1) / (matches + 2), чтобы P = 0 не давала ноль
+        double stdError() const {
+            double p = (wins + 1.0) / (matches + 2.0);
+            return std::sqrt(p * (1 - p) / std::max(1LL, matches));
+        }
+    };
+
+    double tolerance = 0.02;     // допустимая погрешность поверхности
+    int initial_matches = 200;   // матчей на новую точку
+    int coarse = 3;              // начальная сетка coarse × coarse
+    int max_level = 3;           // максимум делений клетки начальной сетки
+    long long max_matches = 20000000; // предел сыгранных матчей (взятые из кэша не считаются)
+    ResultCache* cache = nullptr; // общий кэш точек; повторный свип досчитывает только недостающее
+
+    AdaptiveSweep(double r_min, double r_max, double l_min, double l_max, int n, std::uint64_t seed = 2024)
+        : r_min(r_min), r_max(r_max), l_min(l_min), l_max(l_max), n(n), seed(seed) {
+    }
+
+    void run() {
+        const int fine = finestStep();
+        std::vector<Cell> work;
+        for (int i = 0; i + 1 < coarse; ++i) {
+            for (int j = 0; j + 1 < coarse; ++j) {
+                work.push_back({ i * fine, j * fine, fine, 0 });
+            }
+        }
+
+        leaves.clear();
+        while (!work.empty()) {
+            Cell cell = work.back();
+            work.pop_back();
+
+            const SamplePoint* lo = nullptr;
+            const SamplePoint* hi = nullptr;
+            for (SamplePoint* point : corners(cell)) {
+                ensurePrecision(*point);
+                if (!lo || point->probability() < lo->probability()) lo = point;
+                if (!hi || point->probability() > hi->probability()) hi = point;
+            }
+
+            // Делим клетку, если перепад больше допуска и статистически значим
+            double range = hi->probability() - lo->probability();
+            double noise = 2 * std::hypot(lo->stdError(), hi->stdError());
+            if (range > std::max(tolerance, noise) && cell.level < max_level && total_matches < max_matches) {
+                int half = cell.size / 2;
+                for (int di = 0; di < 2; ++di) {
+                    for (int dj = 0; dj < 2; ++dj) {
+                        work.push_back({ cell.i + di * half, cell.j + dj * half, half, cell.level + 1 });
+                    }
+                }
+            }
+            else {
+                leaves.push_back(cell);
+            }
+        }
+    }
+
+    // Матчи, сыгранные в этом свипе, и взятые из кэша; стоимость свипа - только
+    // сыгранные, иначе сравнение с фиксированной сеткой зависело бы от того, насколько
+    // прогрет кэш
+    long long totalMatches() const { return total_matches; }
+    long long cachedMatchCount() const { return cached_matches; }
+
+    size_t pointCount() const { return samples.size(); }
+
+    // Матчи, на которых построена адаптивная поверхность (сыгранные и взятые из кэша)
+    long long sampleMatches() const {
+        long long matches = 0;
+        for (const auto& entry : samples) {
+            matches += entry.second.matches;
+        }
+        return matches;
+    }
+
+    // Поверхность P(победы) во всех узлах мелкой сетки, по строкам i
+    using Surface = std::vector<double>;
+
+    // Число узлов мелкой сетки по одной оси
+    int fineSide() const { return (coarse - 1) * finestStep() + 1; }
+
+    Surface adaptiveSurface() const {
+        const int side = fineSide();
+        Surface surface(static_cast<size_t>(side) * side);
+        for (int i = 0; i < side; ++i) {
+            for (int j = 0; j < side; ++j) {
+                surface[static_cast<size_t>(i) * side + j] = interpolate(i, j);
+            }
+        }
+        return surface;
+    }
+
+    // Фиксированная сетка: узлы через stride узлов мелкой сетки, matches матчей в каждом,
+    // между узлами - билинейная интерполяция. Зерно выводится из grid и matches, поэтому
+    // выборки разных сеток не пересекаются ни друг с другом, ни с адаптивным свипом,
+    // а кэш отдаёт повторному запуску ровно ту же сетку. В *cost добавляются матчи сетки
+    Surface fixedGridSurface(std::uint64_t grid, int stride, long long matches, long long* cost = nullptr) const {
+        const int side = fineSide();
+        if (stride <= 0 || (side - 1) % stride != 0) {
+            throw std::invalid_argument("шаг фиксированной сетки должен делить мелкую сетку");
+        }
+        std::uint64_t state = seed ^ (grid << 32) ^ static_cast<std::uint64_t>(matches);
+        const std::uint64_t grid_seed = SplitMix64::next(state);
+
+        const int nodes = (side - 1) / stride + 1;
+        std::vector<double> values(static_cast<size_t>(nodes) * nodes);
+        for (int a = 0; a < nodes; ++a) {
+            for (int b = 0; b < nodes; ++b) {
+                double r = r_min + (r_max - r_min) * a / (nodes - 1);
+                double l = l_min + (l_max - l_min) * b / (nodes - 1);
+                CacheRecord record = cachedMatches(cache, r, l, n, grid_seed, matches);
+                values[static_cast<size_t>(a) * nodes + b] = static_cast<double>(record.successes) / record.trials;
+                if (cost) {
+                    *cost += record.trials;
+                }
+            }
+        }
+
+        Surface surface(static_cast<size_t>(side) * side);
+        for (int i = 0; i < side; ++i) {
+            for (int j = 0; j < side; ++j) {
+                int a = std::min(i / stride, nodes - 2);
+                int b = std::min(j / stride, nodes - 2);
+                double u = static_cast<double>(i - a * stride) / stride;
+                double v = static_cast<double>(j - b * stride) / stride;
+                auto at = [&](int x, int y) { return values[static_cast<size_t>(x) * nodes + y]; };
+                surface[static_cast<size_t>(i) * side + j] = (1 - u) * (1 - v) * at(a, b) + u * (1 - v) * at(a + 1, b)
+                    + (1 - u) * v * at(a, b + 1) + u * v * at(a + 1, b + 1);
+            }
+        }
+        return surface;
+    }
+
+    // Среднеквадратичная и максимальная ошибка поверхности относительно эталона
+    struct SurfaceError {
+        double rms = 0;
+        double max = 0;
+    };
+
+    static SurfaceError surfaceError(const Surface& surface, const Surface& reference) {
+        SurfaceError error;
+        for (size_t k = 0; k < surface.size(); ++k) {
+            double diff = std::abs(surface[k] - reference[k]);
+            error.rms += diff * diff;
+            error.max = std::max(error.max, diff);
+        }
+        error.rms = std::sqrt(error.rms / std::max<size_t>(1, surface.size()));
+        return error;
+    }
+
+    // CSV с теми же первыми столбцами, что и experiment_r_l.csv
+    void writeCsv(const std::string& path) const {
+        std::ofstream file(path);
+        file << "r,l,win_probability,matches,std_error,level\n";
+        for (const auto& entry : samples) {
+            const SamplePoint& point = entry.second;
+            file << point.r << "," << point.l << "," << point.probability() << ","
+                << point.matches << "," << point.stdError() << "," << point.level << "\n";
+        }
+    }
+
+private:
+    // Клетка [i, i + size] × [j, j + size] в индексах самой мелкой сетки
+    struct Cell {
+        int i, j, size, level;
+    };
+
+    double r_min, r_max, l_min, l_max;
+    int n;
+    std::uint64_t seed;
+    std::map<std::pair<int, int>, SamplePoint> samples;
+    std::vector<Cell> leaves;
+    long long total_matches = 0;
+    long long cached_matches = 0;
+
+    int finestStep() const { return 1 << max_level; }
+
+    SamplePoint& pointAt(int i, int j, int level) {
+        auto it = samples.find({ i, j });
+        if (it != samples.end()) {
+            return it->second;
+        }
+        const int side = (coarse - 1) * finestStep();
+        SamplePoint& point = samples[{ i, j }];
+        point.r = r_min + (r_max - r_min) * i / side;
+        point.l = l_min + (l_max - l_min) * j / side;
+        point.level = level;
+        return point;
+    }
+
+    std::vector<SamplePoint*> corners(const Cell& cell) {
+        return {
+            &pointAt(cell.i, cell.j, cell.level),
+            &pointAt(cell.i + cell.size, cell.j, cell.level),
+            &pointAt(cell.i, cell.j + cell.size, cell.level),
+            &pointAt(cell.i + cell.size, cell.j + cell.size, cell.level)
+        };
+    }
+
+    // Досчитать матчи в точке, пока погрешность не станет меньше допуска
+    void ensurePrecision(SamplePoint& point) {
+        while (total_matches < max_matches &&
+            (point.matches == 0 || point.stdError() > tolerance)) {
+            long long extra = initial_matches;
+            if (point.matches > 0) {
+                double p = (point.wins + 1.0) / (point.matches + 2.0);
+                long long needed = static_cast<long long>(std::ceil(p * (1 - p) / (tolerance * tolerance)));
+                extra = std::max<long long>(initial_matches / 2, needed - point.matches);
+            }
+            CacheRecord known;
+            known.successes = point.wins;
+            known.trials = point.matches;
+            long long simulated = 0;
+            CacheRecord record = cachedMatches(cache, point.r, point.l, n, seed, point.matches + extra, known,
+                &simulated);
+            total_matches += simulated;
+            cached_matches += record.trials - point.matches - simulated;
+            point.wins = record.successes;
+            point.matches = record.trials;
+        }
+    }
+
+    // Билинейная интерполяция по листу, содержащему узел (i, j) мелкой сетки
+    double interpolate(int i, int j) const {
+        for (const Cell& cell : leaves) {
+            if (i < cell.i || i > cell.i + cell.size || j < cell.j || j > cell.j + cell.size) continue;
+            double u = static_cast<double>(i - cell.i) / cell.size;
+            double v = static_cast<double>(j - cell.j) / cell.size;
+            double p00 = samples.at({ cell.i, cell.j }).probability();
+            double p10 = samples.at({ cell.i + cell.size, cell.j }).probability();
+            double p01 = samples.at({ cell.i, cell.j + cell.size }).probability();
+            double p11 = samples.at({ cell.i + cell.size, cell.j + cell.size }).probability();
+            return (1 - u) * (1 - v) * p00 + u * (1 - v) * p10 + (1 - u) * v * p01 + u * v * p11;
+        }
+        return 0.0;
+    }
+};
+
+// Адаптивный свип по (r, l) и сравнение стоимости с фиксированной сеткой
+void runAdaptiveSweep(double tolerance) {
+    const int fixed_n = 16;
+    ResultCache cache;
+    AdaptiveSweep sweep(0.5, 2.5, 0.5, 2.5, fixed_n);
+    sweep.tolerance = tolerance;
+    sweep.cache = &cache;
+
+    auto start = std::chrono::steady_clock::now();
+    sweep.run();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    sweep.writeCsv("experiment_r_l_adaptive.csv");
+
+    std::cout << "Адаптивный свип по r и l (n = " << fixed_n << ", допуск " << tolerance << ")\n";
+    std::cout << "Точек: " << sweep.pointCount() << ", матчей сыграно: " << sweep.totalMatches()
+        << ", взято из кэша: " << sweep.cachedMatchCount() << ", время: " << seconds << " с\n";
+
+    // Сравнение с фиксированными сетками по измеренной ошибке: эталон - мелкая сетка
+    // с погрешностью в 4 раза меньше допуска, обе фиксированные сетки сыграны на самом деле
+    // (повторный запуск берёт их из кэша). Стоимость сетки - все её матчи
+    const int side = sweep.fineSide();
+    const long long grid_matches = static_cast<long long>(std::ceil(0.25 / (tolerance * tolerance)));
+    AdaptiveSweep::Surface reference = sweep.fixedGridSurface(0, 1, 16 * grid_matches);
+    long long fine_cost = 0;
+    AdaptiveSweep::Surface fine = sweep.fixedGridSurface(1, 1, grid_matches, &fine_cost);
+    const int experiment_nodes = 5;
+    const int experiment_matches = 500;
+    long long experiment_cost = 0;
+    AdaptiveSweep::Surface experiment = sweep.fixedGridSurface(2, (side - 1) / (experiment_nodes - 1),
+        experiment_matches, &experiment_cost);
+
+    auto print = [&](const char* name, long long points, long long matches, const AdaptiveSweep::Surface& surface) {
+        AdaptiveSweep::SurfaceError error = AdaptiveSweep::surfaceError(surface, reference);
+        std::cout << "  " << name << ": точек " << points << ", матчей " << matches
+            << ", ошибка: СКО " << error.rms << ", максимум " << error.max << "\n";
+    };
+    std::cout << "Ошибка поверхности в " << side << " × " << side << " узлах относительно эталона ("
+        << 16 * grid_matches << " матчей в узле):\n";
+    print("адаптивная сетка", static_cast<long long>(sweep.pointCount()), sweep.sampleMatches(), sweep.adaptiveSurface());
+    print("фиксированная сетка того же шага", static_cast<long long>(side) * side, fine_cost, fine);
+    print("сетка runExperiments (5 × 5, 500 матчей)", experiment_nodes * experiment_nodes, experiment_cost, experiment);
+    std::cout << "Данные сохранены в experiment_r_l_adaptive.csv\n";
+}
+
 // Функция для проведения экспериментов и записи результатов
-void runExperiments() {
+// Вывод одного эксперимента: CSV в прежнем виде и/или колоночный .lwc.
+// В .lwc кроме оценки хранится число матчей и 95% интервал Уилсона
+class ExperimentWriter {
+private:
+    std::ofstream csv;
+    std::unique_ptr<ColumnarWriter> lwc;
+    bool integer_y;
+
+public:
+    ExperimentWriter(const std::string& base, const std::string& x_name, const std::string& y_name,
+        bool integer_y, const std::string& format) : integer_y(integer_y) {
+
+        if (format == "csv" || format == "both") {
+            csv.open(base + ".csv");
+            csv << x_name << "," << y_name << ",win_probability\n";
+        }
+        if (format == "lwc" || format == "both") {
+            lwc = std::make_unique<ColumnarWriter>(base + ".lwc", std::vector<ColumnSpec>{
+                { x_name, ColumnType::Float64 },
+                { y_name, integer_y ? ColumnType::Int64 : ColumnType::Float64 },
+                { "win_probability", ColumnType::Float64 },
+                { "matches", ColumnType::Int64 },
+                { "ci_low", ColumnType::Float64 },
+                { "ci_high", ColumnType::Float64 } });
+        }
+    }
+
+    void add(double x, double y, const CacheRecord& record) {
+        double p = static_cast<double>(record.successes) / record.trials;
+        if (csv.is_open()) {
+            csv << x << ",";
+            if (integer_y) csv << static_cast<int>(y); else csv << y;
+            csv << "," << p << "\n";
+        }
+        if (lwc) {
+            const double z = 1.96;
+            double trials = static_cast<double>(record.trials);
+            double denominator = 1.0 + z * z / trials;
+            double center = (p + z * z / (2.0 * trials)) / denominator;
+            double half = z * std::sqrt(p * (1.0 - p) / trials + z * z / (4.0 * trials * trials)) / denominator;
+            if (integer_y) {
+                lwc->addRow(x, static_cast<std::int64_t>(y), p, static_cast<std::int64_t>(record.trials),
+                    center - half, center + half);
+            }
+            else {
+                lwc->addRow(x, y, p, static_cast<std::int64_t>(record.trials), center - half, center + half);
+            }
+        }
+    }
+};
+
+void runExperiments(int num_matches = 500, const std::string& format = "both") {
+    if (format != "csv" && format != "lwc" && format != "both") {
+        throw std::invalid_argument("формат вывода: csv, lwc или both");
+    }
+
+    // Точки берутся из кэша; считаются только отсутствующие или недосчитанные
+    ResultCache cache;
+    const std::uint64_t seed = 2024;
+
     // Параметры для экспериментов
     std::vector<double> r_values = { 0.5, 1.0, 1.5, 2.0, 2.5 };
     std::vector<double> l_values = { 0.5, 1.0, 1.5, 2.0, 2.5 };
@@ -373,70 +1786,278 @@ void runExperiments() {
     int fixed_n = 16;
 
     // Эксперимент 1: меняем r и l, фиксируем n
-    std::ofstream file1("experiment_r_l.csv");
-    file1 << "r,l,win_probability\n";
-
-    std::cout << "Эксперимент 1: меняем r и l (n = " << fixed_n << ")\n";
-    for (double r : r_values) {
-        for (double l : l_values) {
-            TennisSimulator simulator(r, l, fixed_n);
-            double win_prob = simulator.estimateWinProbability(500);
-            file1 << r << "," << l << "," << win_prob << "\n";
-            std::cout << "r=" << r << ", l=" << l << ", win_prob=" << win_prob << std::endl;
+    {
+        ExperimentWriter file1("experiment_r_l", "r", "l", false, format);
+
+        std::cout << "Эксперимент 1: меняем r и l (n = " << fixed_n << ")\n";
+        for (double r : r_values) {
+            for (double l : l_values) {
+                CacheRecord record = cachedMatches(&cache, r, l, fixed_n, seed, num_matches);
+                double win_prob = static_cast<double>(record.successes) / record.trials;
+                file1.add(r, l, record);
+                std::cout << "r=" << r << ", l=" << l << ", win_prob=" << win_prob << std::endl;
+            }
         }
     }
-    file1.close();
 
     // Эксперимент 2: меняем r и n, фиксируем l
-    std::ofstream file2("experiment_r_n.csv");
-    file2 << "r,n,win_probability\n";
-
-    std::cout << "\nЭксперимент 2: меняем r и n (l = " << fixed_l << ")\n";
-    for (double r : r_values) {
-        for (int n : n_values) {
-            try {
-                TennisSimulator simulator(r, fixed_l, n);
-                double win_prob = simulator.estimateWinProbability(500);
-                file2 << r << "," << n << "," << win_prob << "\n";
-                std::cout << "r=" << r << ", n=" << n << ", win_prob=" << win_prob << std::endl;
-            }
-            catch (const std::exception& e) {
-                std::cerr << "Ошибка для n=" << n << ": " << e.what() << std::endl;
+    {
+        ExperimentWriter file2("experiment_r_n", "r", "n", true, format);
+
+        std::cout << "\nЭксперимент 2: меняем r и n (l = " << fixed_l << ")\n";
+        for (double r : r_values) {
+            for (int n : n_values) {
+                try {
+                    CacheRecord record = cachedMatches(&cache, r, fixed_l, n, seed, num_matches);
+                    double win_prob = static_cast<double>(record.successes) / record.trials;
+                    file2.add(r, n, record);
+                    std::cout << "r=" << r << ", n=" << n << ", win_prob=" << win_prob << std::endl;
+                }
+                catch (const std::exception& e) {
+                    std::cerr << "Ошибка для n=" << n << ": " << e.what() << std::endl;
+                }
             }
         }
     }
-    file2.close();
 
     // Эксперимент 3: меняем l и n, фиксируем r
-    std::ofstream file3("experiment_l_n.csv");
-    file3 << "l,n,win_probability\n";
+    {
+        ExperimentWriter file3("experiment_l_n", "l", "n", true, format);
 
-    std::cout << "\nЭксперимент 3: меняем l и n (r = " << fixed_r << ")\n";
-    for (double l : l_values) {
-        for (int n : n_values) {
-            try {
-                TennisSimulator simulator(fixed_r, l, n);
-                double win_prob = simulator.estimateWinProbability(500);
-                file3 << l << "," << n << "," << win_prob << "\n";
-                std::cout << "l=" << l << ", n=" << n << ", win_prob=" << win_prob << std::endl;
-            }
-            catch (const std::exception& e) {
-                std::cerr << "Ошибка для n=" << n << ": " << e.what() << std::endl;
+        std::cout << "\nЭксперимент 3: меняем l и n (r = " << fixed_r << ")\n";
+        for (double l : l_values) {
+            for (int n : n_values) {
+                try {
+                    CacheRecord record = cachedMatches(&cache, fixed_r, l, n, seed, num_matches);
+                    double win_prob = static_cast<double>(record.successes) / record.trials;
+                    file3.add(l, n, record);
+                    std::cout << "l=" << l << ", n=" << n << ", win_prob=" << win_prob << std::endl;
+                }
+                catch (const std::exception& e) {
+                    std::cerr << "Ошибка для n=" << n << ": " << e.what() << std::endl;
+                }
             }
         }
     }
-    file3.close();
 
-    std::cout << "\nЭксперименты завершены. Данные сохранены в файлы CSV.\n";
+    std::cout << "\nЭксперименты завершены. Данные сохранены в файлы "
+        << (format == "csv" ? "CSV" : format == "lwc" ? ".lwc" : "CSV и .lwc") << ".\n";
     std::cout << "Для построения графиков можно использовать следующие команды Python:\n";
-    std::cout << "1. Загрузить данные: data = pd.read_csv('experiment_r_l.csv')\n";
+    std::cout << "1. Загрузить данные: data = read_lwc('experiment_r_l.lwc') (см. LW_A_3.py)\n";
+    std::cout << "   или data = pd.read_csv('experiment_r_l.csv')\n";
     std::cout << "2. Построить тепловую карту: sns.heatmap(data.pivot('r', 'l', 'win_probability'))\n";
     std::cout << "3. Или 3D график: fig = plt.figure(); ax = fig.add_subplot(111, projection='3d')\n";
 }
 
-int main() {
+// Преобразование .lwc в CSV для внешних инструментов
+void convertToCsv(const std::string& path) {
+    ColumnarReader reader(path);
+    std::string target = path.size() > 4 && path.substr(path.size() - 4) == ".lwc"
+        ? path.substr(0, path.size() - 4) + ".csv" : path + ".csv";
+    std::ofstream out(target);
+    reader.writeCsv(out);
+    std::cout << path << ": " << reader.rowCount() << " строк, " << reader.chunkCount()
+        << " блоков -> " << target << "\n";
+}
+
+// Сравнение пакетного симулятора со скалярным: пропускная способность и распределение исходов
+void runBatchBenchmark() {
+    const double r = 1.5, l = 1.0;
+    const int n = 16;
+    const int num_matches = 200000;
+
+    auto start = std::chrono::steady_clock::now();
+    TennisSimulator scalar(r, l, n);
+    double scalar_prob = scalar.estimateWinProbability(num_matches);
+    double scalar_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Пакетное моделирование: r=" << r << ", l=" << l << ", n=" << n
+        << ", матчей=" << num_matches << "\n";
+    std::cout << "Скалярный TennisSimulator: win_prob=" << scalar_prob
+        << ", матчей/с=" << num_matches / scalar_seconds << "\n\n";
+    std::cout << "K,win_prob,matches_per_second,speedup,z_score\n";
+
+    for (int K = 8; K <= 4096; K *= 2) {
+        BatchTennisSimulator batch(r, l, n, K);
+
+        start = std::chrono::steady_clock::now();
+        double batch_prob = batch.estimateWinProbability(num_matches);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // z-статистика разности двух долей: |z| < 3 - распределения исходов совпадают
+        double pooled = (scalar_prob + batch_prob) / 2;
+        double se = std::sqrt(pooled * (1 - pooled) * 2.0 / num_matches);
+        double z = se > 0 ? (batch_prob - scalar_prob) / se : 0.0;
+
+        std::cout << K << "," << batch_prob << "," << num_matches / seconds << ","
+            << scalar_seconds / seconds << "," << z << std::endl;
+    }
+}
+
+// Сравнение цепочки Маркова с полным моделированием матчей
+void runExactComparison() {
+    std::vector<double> r_values = { 0.5, 1.0, 1.5, 2.0, 2.5 };
+    std::vector<double> l_values = { 0.5, 1.0, 1.5, 2.0, 2.5 };
+    const int n = 16;
+    const int num_rallies = 20000;
+    const int num_matches = 5000;
+
+    // Время на точку свипа при известной P(розыгрыш)
+    const int repeats = 100000;
+    auto start = std::chrono::steady_clock::now();
+    double checksum = 0;
+    for (int i = 0; i < repeats; ++i) {
+        checksum += ScoreMarkovChain::matchWinProbabilityFromRally(i / double(repeats));
+    }
+    double chain_us = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - start).count() / repeats;
+    std::cout << "Цепочка Маркова: " << chain_us << " мкс на точку (контроль " << checksum << ")\n\n";
+
+    std::cout << "r,l,p_rally,p_match_exact,stderr_exact,p_match_mc,stderr_mc,z_score\n";
+    for (double r : r_values) {
+        for (double l : l_values) {
+            ExactEstimate exact = solveWinProbability(r, l, n, num_rallies);
+
+            TennisSimulator simulator(r, l, n);
+            double mc = simulator.estimateWinProbability(num_matches);
+            // Дисперсия Монте-Карло по модельному P: не обнуляется при mc = 0
+            double mc_variance = exact.match_variance / num_matches;
+
+            double se = std::sqrt(exact.estimator_variance + mc_variance);
+            double z = se > 0 ? (exact.match_probability - mc) / se : 0.0;
+
+            std::cout << r << "," << l << "," << exact.rally_probability << ","
+                << exact.match_probability << "," << std::sqrt(exact.estimator_variance) << ","
+                << mc << "," << std::sqrt(mc_variance) << "," << z << std::endl;
+        }
+    }
+}
+
+// Сравнение обычного Монте-Карло и выборки по значимости при равном времени счёта
+void runRareEventComparison(double budget_seconds = 1.0) {
+    struct Case { double r, l; int n; };
+    std::vector<Case> cases = { {0.5, 1.0, 16}, {1.0, 1.0, 16}, {1.5, 1.0, 16} };
+    std::vector<double> tilts = { 0.3, 0.5, 0.7, 0.8, 0.9, 0.95 };
+    const int chunk = 1000;
+
+    std::cout << "r,l,n,method,tilt,matches,win_prob,std_error,relative_error\n";
+    for (const auto& c : cases) {
+        TennisSimulator simulator(c.r, c.l, c.n, 4242);
+
+        // Пилотный прогон: доля смещения с наименьшей относительной погрешностью
+        double best_tilt = tilts.front();
+        double best_error = INFINITY;
+        for (double t : tilts) {
+            WeightedEstimate pilot = simulator.estimateWinProbabilityIS(2000, t);
+            if (pilot.relative_error < best_error) {
+                best_error = pilot.relative_error;
+                best_tilt = t;
+            }
+        }
+
+        // Обычный Монте-Карло
+        int matches = 0, wins = 0;
+        auto start = std::chrono::steady_clock::now();
+        while (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < budget_seconds) {
+            wins += static_cast<int>(std::lround(simulator.estimateWinProbability(chunk) * chunk));
+            matches += chunk;
+        }
+        double p = static_cast<double>(wins) / matches;
+        double se = std::sqrt(p * (1 - p) / matches);
+        std::cout << c.r << "," << c.l << "," << c.n << ",mc,0," << matches << "," << p << ","
+            << se << "," << (p > 0 ? se / p : INFINITY) << std::endl;
+
+        // Выборка по значимости: объединение порций с равными весами
+        matches = 0;
+        double sum = 0, sum_sq = 0;
+        start = std::chrono::steady_clock::now();
+        while (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < budget_seconds) {
+            WeightedEstimate part = simulator.estimateWinProbabilityIS(chunk, best_tilt);
+            sum += part.probability * chunk;
+            sum_sq += (part.std_error * part.std_error * (chunk - 1) + part.probability * part.probability) * chunk;
+            matches += chunk;
+        }
+        p = sum / matches;
+        se = std::sqrt(std::max(0.0, sum_sq / matches - p * p) / (matches - 1));
+        std::cout << c.r << "," << c.l << "," << c.n << ",importance," << best_tilt << "," << matches << ","
+            << p << "," << se << "," << (p > 0 ? se / p : INFINITY) << std::endl;
+    }
+}
+
+#ifdef LW_BENCHMARK
+// Эталонные замеры Монте-Карло: фиксированное зерно, несколько размеров сетки
+void runBenchmarks(BenchmarkSuite& suite) {
+    const double r = 1.5, l = 1.0;
+    const std::uint64_t seed = 2024;
+    struct Scale { int n; int matches; };
+    for (Scale scale : { Scale{ 4, 200000 }, Scale{ 16, 200000 }, Scale{ 36, 200000 } }) {
+        suite.measure("scalar_n" + std::to_string(scale.n), "matches/s", [&] {
+            TennisSimulator simulator(r, l, scale.n, seed);
+            simulator.estimateWinProbability(scale.matches);
+            return scale.matches;
+        });
+    }
+    suite.measure("batch_k256_n16", "matches/s", [&] {
+        BatchTennisSimulator batch(r, l, 16, 256, seed);
+        batch.estimateWinProbability(100000);
+        return 100000;
+    });
+}
+#endif
+
+int main(int argc, char* argv[]) {
     setlocale(LC_ALL, "Russian");
+#ifdef LW_BENCHMARK
+    return runBenchmarkMain(argc, argv, "lw_a_3", runBenchmarks);
+#endif
     try {
+        std::string mode = argc > 1 ? argv[1] : "";
+        if (mode == "batch") {
+            runBatchBenchmark();
+            return 0;
+        }
+        if (mode == "exact") {
+            runExactComparison();
+            return 0;
+        }
+        if (mode == "tournament") {
+            double r = argc > 2 ? std::stod(argv[2]) : 2.0;
+            double l = argc > 3 ? std::stod(argv[3]) : 1.0;
+            int n = argc > 4 ? std::stoi(argv[4]) : 16;
+            int num_matches = argc > 5 ? std::stoi(argv[5]) : 5000;
+
+            std::cout << "Турнир стратегий: r=" << r << ", l=" << l << ", n=" << n
+                << ", матчей=" << num_matches << "\n";
+            printTournament(runTournament<FarthestSquareStrategy, RandomSquareStrategy,
+                ReachAwareStrategy, LookaheadStrategy>(r, l, n, num_matches, 12345));
+            return 0;
+        }
+        if (mode == "rare") {
+            runRareEventComparison(argc > 2 ? std::stod(argv[2]) : 1.0);
+            return 0;
+        }
+        if (mode == "sweep") {
+            runExperiments(argc > 2 ? std::stoi(argv[2]) : 500, argc > 3 ? argv[3] : "both");
+            return 0;
+        }
+        if (mode == "lwc2csv" && argc > 2) {
+            for (int i = 2; i < argc; ++i) {
+                convertToCsv(argv[i]);
+            }
+            return 0;
+        }
+        if (mode == "adaptive") {
+            runAdaptiveSweep(argc > 2 ? std::stod(argv[2]) : 0.02);
+            return 0;
+        }
+        if (mode == "optimize") {
+            double r = argc > 2 ? std::stod(argv[2]) : 2.0;
+            double l = argc > 3 ? std::stod(argv[3]) : 1.0;
+            int n = argc > 4 ? std::stoi(argv[4]) : 16;
+            runPolicyOptimization(r, l, n);
+            return 0;
+        }
+
         // Пример одиночного запуска
         TennisSimulator simulator(1.5, 1.0, 16);
         std::cout << "Тестовый запуск...\n";
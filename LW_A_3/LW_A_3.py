@@ -3,9 +3,57 @@ import seaborn as sns
 import matplotlib.pyplot as plt
 import numpy as np
 from mpl_toolkits.mplot3d import Axes3D
+import os
+import struct
+
+# Типы столбцов формата .lwc (см. common/ColumnarFile.h)
+LWC_TYPES = {0: np.float64, 1: np.int64, 2: np.int32, 3: np.uint8}
+
+
+def read_lwc(path):
+    """Чтение колоночного файла .lwc через отображение в память (без разбора текста)."""
+    raw = np.memmap(path, dtype=np.uint8, mode='r')
+    if bytes(raw[:8]) != b'LWCOL001':
+        raise ValueError(f'{path}: не файл формата .lwc')
+    (count,) = struct.unpack_from('<I', raw, 8)
+    offset = 16
+    schema = []
+    for _ in range(count):
+        kind, _, name_length = struct.unpack_from('<BBH', raw, offset)
+        offset += 4
+        schema.append((bytes(raw[offset:offset + name_length]).decode(), LWC_TYPES[kind]))
+        offset += name_length
+    offset = (offset + 7) // 8 * 8
+
+    parts = {name: [] for name, _ in schema}
+    while offset + 16 <= len(raw) and bytes(raw[offset:offset + 8]) == b'LWCHUNK1':
+        (rows,) = struct.unpack_from('<Q', raw, offset + 8)
+        position = offset + 16
+        columns = []
+        for name, dtype in schema:
+            size = rows * np.dtype(dtype).itemsize
+            if position + size > len(raw):
+                break
+            columns.append((name, np.frombuffer(raw, dtype=dtype, count=rows, offset=position)))
+            position += (size + 7) // 8 * 8
+        if len(columns) < len(schema):
+            break  # недописанный блок
+        for name, values in columns:
+            parts[name].append(values)
+        offset = position
+    return pd.DataFrame({name: np.concatenate(parts[name]) if parts[name] else np.array([], dtype=dtype)
+                         for name, dtype in schema})
+
+
+def load_experiment(base):
+    """Колоночный файл, если есть; иначе прежний CSV."""
+    if os.path.exists(base + '.lwc'):
+        return read_lwc(base + '.lwc')
+    return pd.read_csv(base + '.csv')
+
 
 # Загрузка данных
-data = pd.read_csv('experiment_r_l.csv')
+data = load_experiment('experiment_r_l')
 
 # Тепловая карта (исправленный синтаксис)
 pivot_table = data.pivot(index='r', columns='l', values='win_probability')
@@ -43,7 +91,7 @@ plt.show()
 
 # Анализ других экспериментов
 print("Анализ эксперимента 2 (r и n):")
-data2 = pd.read_csv('experiment_r_n.csv')
+data2 = load_experiment('experiment_r_n')
 if 'n' in data2.columns:
     # Для каждого r построим график зависимости от n
     for r_val in sorted(data2['r'].unique()):
@@ -58,7 +106,7 @@ if 'n' in data2.columns:
     plt.show()
 
 print("Анализ эксперимента 3 (l и n):")
-data3 = pd.read_csv('experiment_l_n.csv')
+data3 = load_experiment('experiment_l_n')
 if 'n' in data3.columns:
     # Тепловая карта для l и n
     pivot_table3 = data3.pivot(index='l', columns='n', values='win_probability')
@@ -75,3 +123,29 @@ print("Эксперимент 1 (r и l):")
 max_idx = data['win_probability'].idxmax()
 print(f"  Максимальная вероятность: {data.loc[max_idx, 'win_probability']:.3f}")
 print(f"  При r={data.loc[max_idx, 'r']}, l={data.loc[max_idx, 'l']}")
+
+# Адаптивный свип (нерегулярная сетка): pivot не подходит, строим по триангуляции
+if os.path.exists('experiment_r_l_adaptive.csv'):
+    print("\nАнализ адаптивного свипа (r и l):")
+    data_a = pd.read_csv('experiment_r_l_adaptive.csv')
+    print(f"  Точек: {len(data_a)}, матчей: {data_a['matches'].sum()}")
+
+    plt.figure(figsize=(10, 8))
+    contour = plt.tricontourf(data_a['l'], data_a['r'], data_a['win_probability'], levels=20, cmap="YlOrRd")
+    plt.scatter(data_a['l'], data_a['r'], s=10, c='k')
+    plt.colorbar(contour)
+    plt.title("Вероятность победы агента (адаптивная сетка)")
+    plt.xlabel('l (максимальное перемещение)')
+    plt.ylabel('r (радиус болванчика)')
+    plt.show()
+
+    fig = plt.figure(figsize=(12, 10))
+    ax = fig.add_subplot(111, projection='3d')
+    surf = ax.plot_trisurf(data_a['l'], data_a['r'], data_a['win_probability'], cmap='viridis', alpha=0.8)
+    ax.set_xlabel('l (максимальное перемещение)')
+    ax.set_ylabel('r (радиус болванчика)')
+    ax.set_zlabel('Вероятность победы')
+    fig.colorbar(surf, shrink=0.5, aspect=10)
+    plt.title("3D поверхность (адаптивная сетка)")
+    plt.tight_layout()
+    plt.show()
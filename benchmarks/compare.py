@@ -0,0 +1,82 @@
+"""Сравнение эталонных замеров с сохранённым эталоном.
+
+Файлы замеров пишут программы bench_lw_a_N (--out): строки
+"набор/замер единица значение", где значение - пропускная способность
+(больше - лучше). Замер считается регрессией, если он упал относительно
+эталона больше чем на --tolerance. С --update эталон заменяется текущими
+значениями (замеры, которых нет в текущем прогоне, сохраняются).
+
+    python3 benchmarks/compare.py --baseline benchmarks/baseline.txt build/bench_*.txt
+"""
+
+import argparse
+import platform
+import sys
+from datetime import date
+
+
+def read_results(path):
+    results = {}
+    with open(path, encoding='utf-8') as f:
+        for line in f:
+            line = line.strip()
+            if not line or line.startswith('#'):
+                continue
+            name, unit, value = line.split()
+            results[name] = (unit, float(value))
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Сравнение замеров с эталоном')
+    parser.add_argument('results', nargs='+', help='файлы замеров')
+    parser.add_argument('--baseline', required=True, help='файл эталона')
+    parser.add_argument('--tolerance', type=float, default=0.15,
+                        help='допустимое относительное падение (0.15 = 15%%)')
+    parser.add_argument('--update', action='store_true', help='записать текущие значения в эталон')
+    args = parser.parse_args()
+
+    current = {}
+    for path in args.results:
+        current.update(read_results(path))
+
+    try:
+        baseline = read_results(args.baseline)
+    except FileNotFoundError:
+        baseline = {}
+
+    if args.update:
+        merged = dict(baseline)
+        merged.update(current)
+        with open(args.baseline, 'w', encoding='utf-8') as f:
+            f.write(f'# Эталон замеров: {platform.machine()} {platform.system()}, {date.today()}\n')
+            for name in sorted(merged):
+                unit, value = merged[name]
+                f.write(f'{name} {unit} {value:.6g}\n')
+        print(f'Эталон обновлён: {args.baseline} ({len(current)} замеров)')
+        return 0
+
+    regressions = 0
+    print(f'{"замер":<40}{"эталон":>14}{"сейчас":>14}{"отношение":>11}')
+    for name in sorted(current):
+        unit, value = current[name]
+        if name not in baseline:
+            print(f'{name:<40}{"-":>14}{value:>14.4g}{"":>11}  новый')
+            continue
+        reference = baseline[name][1]
+        ratio = value / reference if reference > 0 else float('inf')
+        status = ''
+        if ratio < 1.0 - args.tolerance:
+            status = '  РЕГРЕССИЯ'
+            regressions += 1
+        print(f'{name:<40}{reference:>14.4g}{value:>14.4g}{ratio:>11.3f}{status}')
+
+    if regressions:
+        print(f'\nРегрессий: {regressions} (допуск {args.tolerance:.0%})')
+        return 1
+    print(f'\nРегрессий нет (допуск {args.tolerance:.0%})')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
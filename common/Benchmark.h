@@ -0,0 +1,94 @@
+﻿#pragma once
+
+// Замеры пропускной способности для эталонных прогонов (сборка с LW_BENCHMARK).
+// Каждый замер повторяется несколько раз, в зачёт идёт самый быстрый повтор:
+// он меньше всего искажён фоновой нагрузкой. Результаты печатаются таблицей
+// и при необходимости сохраняются строками "набор/замер единица значение",
+// которые сравнивает с эталоном benchmarks/compare.py.
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+struct BenchmarkResult {
+    std::string name;
+    std::string unit;   // например "events/s"
+    double items;       // обработано за лучший повтор
+    double seconds;     // время лучшего повтора
+
+    double rate() const { return items / seconds; }
+};
+
+class BenchmarkSuite {
+private:
+    std::string suite;
+    int repetitions;
+    std::vector<BenchmarkResult> results;
+
+public:
+    explicit BenchmarkSuite(std::string name, int repetitions = 3)
+        : suite(std::move(name)), repetitions(repetitions) {
+    }
+
+    // body() выполняет одну итерацию замера и возвращает число обработанных единиц
+    template <class Body>
+    const BenchmarkResult& measure(const std::string& name, const std::string& unit, Body body) {
+        BenchmarkResult best{ name, unit, 0.0, 0.0 };
+        for (int i = 0; i < repetitions; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            double items = static_cast<double>(body());
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            seconds = std::max(seconds, 1e-9);
+            if (i == 0 || items / seconds > best.rate()) {
+                best.items = items;
+                best.seconds = seconds;
+            }
+        }
+        results.push_back(best);
+        std::cout << std::left << std::setw(40) << (suite + "/" + name)
+            << std::right << std::setw(14) << std::setprecision(4) << std::scientific << best.rate()
+            << " " << std::left << std::setw(12) << unit
+            << std::fixed << std::setprecision(3) << best.seconds << " с" << std::endl;
+        std::cout.unsetf(std::ios::floatfield);
+        return results.back();
+    }
+
+    void save(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out) {
+            throw std::runtime_error("не удалось записать " + path);
+        }
+        out << std::setprecision(6);
+        for (const auto& result : results) {
+            out << suite << "/" << result.name << " " << result.unit << " " << result.rate() << "\n";
+        }
+    }
+};
+
+// Общая точка входа: "[--out файл] [--reps N]"
+template <class Run>
+int runBenchmarkMain(int argc, char* argv[], const std::string& suite_name, Run run) {
+    std::string out_path;
+    int repetitions = 3;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--out" && i + 1 < argc) out_path = argv[++i];
+        else if (arg == "--reps" && i + 1 < argc) repetitions = std::stoi(argv[++i]);
+        else {
+            std::cerr << "Использование: " << argv[0] << " [--out файл] [--reps N]" << std::endl;
+            return 2;
+        }
+    }
+
+    BenchmarkSuite suite(suite_name, repetitions);
+    run(suite);
+    if (!out_path.empty()) {
+        suite.save(out_path);
+    }
+    return 0;
+}
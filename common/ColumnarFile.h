@@ -0,0 +1,385 @@
+﻿#pragma once
+
+// Колоночный двоичный формат результатов (.lwc) и чтение через отображение в память.
+//
+// Файл: заголовок со схемой и последовательность независимых блоков (chunk).
+//   заголовок: "LWCOL001", uint32 число столбцов, uint32 резерв,
+//              для каждого столбца: uint8 тип, uint8 резерв, uint16 длина имени, имя;
+//              выравнивание до 8 байт
+//   блок:      "LWCHUNK1", uint64 число строк,
+//              для каждого столбца: значения подряд, выравнивание до 8 байт
+// Числа хранятся в порядке байт little-endian. Блоки только дописываются в конец,
+// поэтому файл можно пополнять между запусками; недописанный хвост (запись упала
+// посреди блока) при чтении отбрасывается, а перед дописыванием обрезается.
+// Значения столбца в блоке выровнены и читаются без копирования.
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "MappedFile.h"
+
+enum class ColumnType : std::uint8_t {
+    Float64 = 0,
+    Int64 = 1,
+    Int32 = 2,
+    UInt8 = 3
+};
+
+struct ColumnSpec {
+    std::string name;
+    ColumnType type;
+
+    bool operator==(const ColumnSpec& other) const {
+        return name == other.name && type == other.type;
+    }
+};
+
+namespace columnar {
+
+const char FILE_MAGIC[8] = { 'L', 'W', 'C', 'O', 'L', '0', '0', '1' };
+const char CHUNK_MAGIC[8] = { 'L', 'W', 'C', 'H', 'U', 'N', 'K', '1' };
+
+inline size_t typeSize(ColumnType type) {
+    switch (type) {
+    case ColumnType::Float64: return 8;
+    case ColumnType::Int64: return 8;
+    case ColumnType::Int32: return 4;
+    case ColumnType::UInt8: return 1;
+    }
+    throw std::invalid_argument("неизвестный тип столбца");
+}
+
+template <class T>
+constexpr ColumnType typeOf() {
+    if constexpr (std::is_same_v<T, double>) return ColumnType::Float64;
+    else if constexpr (std::is_same_v<T, std::int64_t>) return ColumnType::Int64;
+    else if constexpr (std::is_same_v<T, std::int32_t>) return ColumnType::Int32;
+    else {
+        static_assert(std::is_same_v<T, std::uint8_t>, "неподдерживаемый тип столбца");
+        return ColumnType::UInt8;
+    }
+}
+
+inline size_t padded(size_t bytes) {
+    return (bytes + 7) / 8 * 8;
+}
+
+// Разбор заголовка; возвращает размер заголовка в байтах
+inline size_t parseHeader(const unsigned char* data, size_t size, std::vector<ColumnSpec>& schema) {
+    if (size < 16 || std::memcmp(data, FILE_MAGIC, 8) != 0) {
+        throw std::runtime_error("не файл формата .lwc");
+    }
+    std::uint32_t count;
+    std::memcpy(&count, data + 8, 4);
+
+    size_t offset = 16;
+    schema.clear();
+    for (std::uint32_t c = 0; c < count; ++c) {
+        if (offset + 4 > size) throw std::runtime_error("повреждённый заголовок .lwc");
+        ColumnSpec spec;
+        spec.type = static_cast<ColumnType>(data[offset]);
+        std::uint16_t name_length;
+        std::memcpy(&name_length, data + offset + 2, 2);
+        offset += 4;
+        if (offset + name_length > size) throw std::runtime_error("повреждённый заголовок .lwc");
+        spec.name.assign(reinterpret_cast<const char*>(data + offset), name_length);
+        offset += name_length;
+        schema.push_back(spec);
+    }
+    return padded(offset);
+}
+
+// Заголовок из начала потока: читается только он, а не весь файл
+inline size_t readHeader(std::istream& in, std::vector<ColumnSpec>& schema) {
+    std::vector<unsigned char> header(16);
+    if (!in.read(reinterpret_cast<char*>(header.data()), 16) || std::memcmp(header.data(), FILE_MAGIC, 8) != 0) {
+        throw std::runtime_error("не файл формата .lwc");
+    }
+    std::uint32_t count;
+    std::memcpy(&count, header.data() + 8, 4);
+
+    for (std::uint32_t c = 0; c < count; ++c) {
+        size_t offset = header.size();
+        header.resize(offset + 4);
+        if (!in.read(reinterpret_cast<char*>(header.data() + offset), 4)) {
+            throw std::runtime_error("повреждённый заголовок .lwc");
+        }
+        std::uint16_t name_length;
+        std::memcpy(&name_length, header.data() + offset + 2, 2);
+        header.resize(offset + 4 + name_length);
+        if (!in.read(reinterpret_cast<char*>(header.data() + offset + 4), name_length)) {
+            throw std::runtime_error("повреждённый заголовок .lwc");
+        }
+    }
+    return parseHeader(header.data(), header.size(), schema);
+}
+
+// Конец блока из rows строк, данные которого начинаются с position, или 0, если блок
+// не помещается в size байт. rows прочитано из файла, поэтому каждый столбец проверяется
+// до умножения: повреждённое значение иначе переполнило бы размер столбца.
+// В offsets (если задан) добавляются смещения столбцов
+inline std::uint64_t chunkEnd(std::uint64_t position, std::uint64_t rows, std::uint64_t size,
+    const std::vector<ColumnSpec>& schema, std::vector<size_t>* offsets = nullptr) {
+    for (const auto& spec : schema) {
+        if (position > size || rows > (size - position) / typeSize(spec.type)) {
+            return 0;
+        }
+        if (offsets) {
+            offsets->push_back(static_cast<size_t>(position));
+        }
+        position += padded(static_cast<size_t>(rows) * typeSize(spec.type));
+    }
+    return position <= size ? position : 0;
+}
+
+// Конец последнего целого блока после заголовка длиной offset: по потоку читаются
+// только заголовки блоков, данные пропускаются
+inline std::uint64_t completeLength(std::istream& in, std::uint64_t offset, std::uint64_t size,
+    const std::vector<ColumnSpec>& schema) {
+    while (offset + 16 <= size) {
+        char magic[8];
+        std::uint64_t rows;
+        in.seekg(static_cast<std::streamoff>(offset));
+        in.read(magic, 8);
+        in.read(reinterpret_cast<char*>(&rows), 8);
+        if (!in || std::memcmp(magic, CHUNK_MAGIC, 8) != 0) {
+            break;
+        }
+
+        std::uint64_t position = chunkEnd(offset + 16, rows, size, schema);
+        if (position == 0) {
+            break; // недописанный блок
+        }
+        offset = position;
+    }
+    return offset;
+}
+
+inline std::vector<unsigned char> encodeHeader(const std::vector<ColumnSpec>& schema) {
+    std::vector<unsigned char> header(16, 0);
+    std::uint32_t count = static_cast<std::uint32_t>(schema.size());
+    std::memcpy(header.data(), FILE_MAGIC, 8);
+    std::memcpy(header.data() + 8, &count, 4);
+    for (const auto& spec : schema) {
+        std::uint16_t name_length = static_cast<std::uint16_t>(spec.name.size());
+        header.push_back(static_cast<unsigned char>(spec.type));
+        header.push_back(0);
+        header.push_back(static_cast<unsigned char>(name_length & 0xFF));
+        header.push_back(static_cast<unsigned char>(name_length >> 8));
+        header.insert(header.end(), spec.name.begin(), spec.name.end());
+    }
+    header.resize(padded(header.size()), 0);
+    return header;
+}
+
+} // namespace columnar
+
+// Запись по строкам с буферизацией по столбцам; блок сбрасывается каждые chunk_rows строк
+class ColumnarWriter {
+private:
+    std::ofstream file;
+    std::vector<ColumnSpec> schema;
+    std::vector<std::vector<unsigned char>> buffers;
+    size_t rows = 0;
+    size_t chunk_rows;
+
+public:
+    ColumnarWriter(const std::string& path, std::vector<ColumnSpec> columns, bool append = false,
+        size_t chunk_rows = 65536)
+        : schema(std::move(columns)), buffers(schema.size()), chunk_rows(chunk_rows) {
+
+        if (append && std::filesystem::exists(path)) {
+            // Блоки после недописанного читатель не увидел бы: файл обрезается
+            // по концу последнего целого блока, и только потом дописывается
+            std::uint64_t size = std::filesystem::file_size(path);
+            std::uint64_t complete;
+            {
+                std::ifstream existing(path, std::ios::binary);
+                if (!existing) {
+                    throw std::runtime_error("не удалось открыть файл " + path);
+                }
+                std::vector<ColumnSpec> stored;
+                size_t header = columnar::readHeader(existing, stored);
+                if (stored != schema) {
+                    throw std::runtime_error("схема не совпадает с файлом " + path);
+                }
+                complete = columnar::completeLength(existing, header, size, schema);
+            }
+            if (complete < size) {
+                std::filesystem::resize_file(path, complete);
+            }
+
+            file.open(path, std::ios::binary | std::ios::app);
+            if (!file) {
+                throw std::runtime_error("не удалось открыть файл для дописывания " + path);
+            }
+            return;
+        }
+
+        file.open(path, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            throw std::runtime_error("не удалось создать файл " + path);
+        }
+        auto header = columnar::encodeHeader(schema);
+        file.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+    }
+
+    ~ColumnarWriter() {
+        flush();
+    }
+
+    ColumnarWriter(const ColumnarWriter&) = delete;
+    ColumnarWriter& operator=(const ColumnarWriter&) = delete;
+
+    // Строка целиком; типы аргументов должны совпадать с типами столбцов
+    template <class... T>
+    void addRow(const T&... values) {
+        if (sizeof...(T) != schema.size()) {
+            throw std::invalid_argument("число значений не совпадает с числом столбцов");
+        }
+        size_t column = 0;
+        (append(column++, values), ...);
+        if (++rows >= chunk_rows) {
+            flush();
+        }
+    }
+
+    // Записать накопленные строки отдельным блоком
+    void flush() {
+        if (rows == 0) return;
+
+        std::uint64_t count = rows;
+        file.write(columnar::CHUNK_MAGIC, 8);
+        file.write(reinterpret_cast<const char*>(&count), 8);
+
+        const char zeros[8] = {};
+        for (auto& buffer : buffers) {
+            file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+            file.write(zeros, static_cast<std::streamsize>(columnar::padded(buffer.size()) - buffer.size()));
+            buffer.clear();
+        }
+        file.flush();
+        rows = 0;
+    }
+
+private:
+    template <class T>
+    void append(size_t column, const T& value) {
+        if (columnar::typeOf<T>() != schema[column].type) {
+            throw std::invalid_argument("тип значения не совпадает со столбцом " + schema[column].name);
+        }
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+        buffers[column].insert(buffers[column].end(), bytes, bytes + sizeof(T));
+    }
+};
+
+// Непрерывный фрагмент столбца внутри отображённого файла
+template <class T>
+struct ColumnView {
+    const T* values;
+    size_t count;
+
+    const T* begin() const { return values; }
+    const T* end() const { return values + count; }
+    size_t size() const { return count; }
+    T operator[](size_t i) const { return values[i]; }
+};
+
+class ColumnarReader {
+private:
+    struct Chunk {
+        size_t rows;
+        std::vector<size_t> offsets; // смещение каждого столбца от начала файла
+    };
+
+    MappedFile file;
+    std::vector<ColumnSpec> schema;
+    std::vector<Chunk> chunks;
+    size_t total_rows = 0;
+
+public:
+    explicit ColumnarReader(const std::string& path) : file(path) {
+        const unsigned char* data = file.data();
+        size_t size = file.size();
+        size_t offset = columnar::parseHeader(data, size, schema);
+
+        while (offset + 16 <= size && std::memcmp(data + offset, columnar::CHUNK_MAGIC, 8) == 0) {
+            std::uint64_t rows;
+            std::memcpy(&rows, data + offset + 8, 8);
+
+            Chunk chunk;
+            chunk.rows = static_cast<size_t>(rows);
+            std::uint64_t position = columnar::chunkEnd(offset + 16, rows, size, schema, &chunk.offsets);
+            if (position == 0) {
+                break; // недописанный или повреждённый блок
+            }
+            chunks.push_back(std::move(chunk));
+            total_rows += static_cast<size_t>(rows);
+            offset = static_cast<size_t>(position);
+        }
+    }
+
+    const std::vector<ColumnSpec>& columns() const { return schema; }
+    size_t chunkCount() const { return chunks.size(); }
+    size_t rowCount() const { return total_rows; }
+    size_t chunkRows(size_t chunk) const { return chunks[chunk].rows; }
+
+    // Файл будет читаться от начала к концу: ядро читает вперёд агрессивнее
+    void adviseSequential() const {
+        file.adviseSequential();
+    }
+
+    // Заранее подкачать блок (например, следующий за обрабатываемым)
+    void prefetchChunk(size_t chunk) const {
+        if (chunk >= chunks.size() || chunks[chunk].offsets.empty()) return;
+        const Chunk& c = chunks[chunk];
+        size_t end = chunk + 1 < chunks.size() ? chunks[chunk + 1].offsets.front() - 16 : file.size();
+        file.prefetch(c.offsets.front(), end - c.offsets.front());
+    }
+
+    size_t columnIndex(const std::string& name) const {
+        for (size_t c = 0; c < schema.size(); ++c) {
+            if (schema[c].name == name) return c;
+        }
+        throw std::out_of_range("нет столбца " + name);
+    }
+
+    // Столбец блока без копирования
+    template <class T>
+    ColumnView<T> column(size_t chunk, size_t column) const {
+        if (columnar::typeOf<T>() != schema[column].type) {
+            throw std::invalid_argument("тип не совпадает со столбцом " + schema[column].name);
+        }
+        const Chunk& c = chunks[chunk];
+        return { reinterpret_cast<const T*>(file.data() + c.offsets[column]), c.rows };
+    }
+
+    // Экспорт в CSV (тот же вид, что и при прямой записи через std::ofstream)
+    void writeCsv(std::ostream& out) const {
+        for (size_t c = 0; c < schema.size(); ++c) {
+            out << schema[c].name << (c + 1 < schema.size() ? "," : "\n");
+        }
+        for (size_t k = 0; k < chunks.size(); ++k) {
+            for (size_t row = 0; row < chunks[k].rows; ++row) {
+                for (size_t c = 0; c < schema.size(); ++c) {
+                    const unsigned char* base = file.data() + chunks[k].offsets[c];
+                    switch (schema[c].type) {
+                    case ColumnType::Float64: out << reinterpret_cast<const double*>(base)[row]; break;
+                    case ColumnType::Int64: out << reinterpret_cast<const std::int64_t*>(base)[row]; break;
+                    case ColumnType::Int32: out << reinterpret_cast<const std::int32_t*>(base)[row]; break;
+                    case ColumnType::UInt8: out << static_cast<int>(base[row]); break;
+                    }
+                    out << (c + 1 < schema.size() ? "," : "\n");
+                }
+            }
+        }
+    }
+};
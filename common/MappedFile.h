@@ -0,0 +1,127 @@
+﻿#pragma once
+
+// Отображение файла в память только для чтения (Windows и POSIX).
+// Данные читаются напрямую из страничного кэша, без копирования в буферы.
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+class MappedFile {
+private:
+    const unsigned char* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+
+public:
+    explicit MappedFile(const std::string& path) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("не удалось открыть файл " + path);
+        }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size)) {
+            close();
+            throw std::runtime_error("не удалось узнать размер файла " + path);
+        }
+        length = static_cast<size_t>(size.QuadPart);
+        if (length > 0) {
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!mapping) {
+                close();
+                throw std::runtime_error("не удалось отобразить файл " + path);
+            }
+            bytes = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        }
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("не удалось открыть файл " + path);
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            close();
+            throw std::runtime_error("не удалось узнать размер файла " + path);
+        }
+        length = static_cast<size_t>(info.st_size);
+        if (length > 0) {
+            void* address = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+            if (address == MAP_FAILED) {
+                close();
+                throw std::runtime_error("не удалось отобразить файл " + path);
+            }
+            bytes = static_cast<const unsigned char*>(address);
+        }
+#endif
+    }
+
+    ~MappedFile() {
+        close();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+    // Подсказка ядру: файл читается последовательно, упреждающее чтение агрессивнее
+    void adviseSequential() const {
+#ifndef _WIN32
+        if (bytes) {
+            madvise(const_cast<unsigned char*>(bytes), length, MADV_SEQUENTIAL);
+        }
+#endif
+    }
+
+    // Запросить подкачку диапазона заранее (упреждающее чтение следующего окна)
+    void prefetch(size_t offset, size_t count) const {
+        if (!bytes || offset >= length) return;
+        if (count > length - offset) count = length - offset;
+#ifdef _WIN32
+        WIN32_MEMORY_RANGE_ENTRY range;
+        range.VirtualAddress = const_cast<unsigned char*>(bytes + offset);
+        range.NumberOfBytes = count;
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t begin = offset / page * page;
+        madvise(const_cast<unsigned char*>(bytes + begin), count + (offset - begin), MADV_WILLNEED);
+#endif
+    }
+
+private:
+    void close() {
+#ifdef _WIN32
+        if (bytes) UnmapViewOfFile(bytes);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (bytes) munmap(const_cast<unsigned char*>(bytes), length);
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+#endif
+        bytes = nullptr;
+    }
+};
@@ -0,0 +1,254 @@
+﻿#pragma once
+
+// Инструментирование горячих участков: счётчики, таймеры и гистограммы.
+// Включается определением LW_PROFILE (в CMake: -DLW_PROFILE=ON); без него все
+// макросы раскрываются в пустые выражения и в код не попадают.
+//
+//   LW_COUNT("run/heap_push");            // +1 к счётчику
+//   LW_COUNT_ADD("run/bytes", n);         // +n к счётчику
+//   LW_HISTOGRAM("rally/strokes", k);     // значение в гистограмму с корзинами по степеням двойки
+//   LW_TIMER("run/report");               // время до конца области видимости
+//   LW_PHASE("run");                      // таймер фазы; пробы "run/..." выводятся под ней
+//
+// Каждая точка замера регистрируется один раз (статическая переменная в месте
+// вызова), дальше запись - инкремент в массиве своего потока без блокировок.
+// Таймеры считают такты TSC; перевод в наносекунды калибруется по steady_clock
+// за всё время работы. Массивы потоков сливаются при завершении потока, итоговый
+// профиль печатается в stderr и пишется в JSON (LW_PROFILE_OUT, по умолчанию
+// lw_profile.json) при завершении программы.
+
+#ifdef LW_PROFILE
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace profiling {
+
+enum class ProbeKind { Counter, Histogram, Timer };
+
+inline std::uint64_t ticks() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+// Накопитель одной точки замера; корзина k - значения с k значащими битами
+struct ProbeSlot {
+    std::uint64_t count = 0;
+    std::uint64_t sum = 0;
+    std::uint64_t max = 0;
+    std::uint64_t buckets[65] = {};
+
+    void add(std::uint64_t value) {
+        ++count;
+        sum += value;
+        max = std::max(max, value);
+        int bits = 0;
+        for (std::uint64_t v = value; v; v >>= 1) ++bits;
+        ++buckets[bits];
+    }
+
+    void merge(const ProbeSlot& other) {
+        count += other.count;
+        sum += other.sum;
+        max = std::max(max, other.max);
+        for (int k = 0; k < 65; ++k) buckets[k] += other.buckets[k];
+    }
+};
+
+class Registry {
+private:
+    struct Probe {
+        std::string name;
+        ProbeKind kind;
+    };
+
+    std::mutex mutex;
+    std::vector<Probe> probes;
+    std::vector<ProbeSlot> totals;
+    std::uint64_t start_ticks;
+    std::chrono::steady_clock::time_point start_time;
+
+    Registry() : start_ticks(ticks()), start_time(std::chrono::steady_clock::now()) {
+    }
+
+public:
+    static Registry& instance() {
+        static Registry registry;
+        return registry;
+    }
+
+    ~Registry() {
+        report();
+    }
+
+    int probe(const std::string& name, ProbeKind kind) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < probes.size(); ++i) {
+            if (probes[i].name == name) return static_cast<int>(i);
+        }
+        probes.push_back({ name, kind });
+        totals.emplace_back();
+        return static_cast<int>(probes.size() - 1);
+    }
+
+    void merge(const std::vector<ProbeSlot>& slots) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < slots.size() && i < totals.size(); ++i) {
+            totals[i].merge(slots[i]);
+        }
+    }
+
+private:
+    void report() {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        double ns_per_tick = seconds > 0 ? seconds * 1e9 / static_cast<double>(ticks() - start_ticks) : 1.0;
+
+        // Фазы - пробы без '/', остальные выводятся под своей фазой
+        std::vector<size_t> order(probes.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return probes[a].name < probes[b].name; });
+
+        std::ostream& out = std::cerr;
+        out << "\n=== Профиль (" << std::fixed << std::setprecision(3) << seconds << " с) ===\n";
+        for (size_t i : order) {
+            const Probe& p = probes[i];
+            const ProbeSlot& s = totals[i];
+            bool nested = p.name.find('/') != std::string::npos;
+            out << (nested ? "  " : "") << std::left << std::setw(nested ? 34 : 36) << p.name << std::right;
+            if (p.kind == ProbeKind::Counter) {
+                out << std::setw(16) << s.sum << "\n";
+            }
+            else if (p.kind == ProbeKind::Timer) {
+                double total_ms = s.sum * ns_per_tick / 1e6;
+                out << std::setw(16) << s.count << " раз, " << std::setprecision(3) << total_ms << " мс, "
+                    << (s.count ? s.sum * ns_per_tick / s.count : 0.0) << " нс в среднем\n";
+            }
+            else {
+                out << std::setw(16) << s.count << " зн., среднее " << std::setprecision(3)
+                    << (s.count ? static_cast<double>(s.sum) / s.count : 0.0) << ", макс " << s.max << "\n";
+                for (int k = 0; k < 65; ++k) {
+                    if (!s.buckets[k]) continue;
+                    std::uint64_t low = k ? (std::uint64_t(1) << (k - 1)) : 0;
+                    std::uint64_t high = k ? (k < 64 ? (std::uint64_t(1) << k) - 1 : ~std::uint64_t(0)) : 0;
+                    out << "      [" << low << ", " << high << "]: " << s.buckets[k] << "\n";
+                }
+            }
+        }
+
+        const char* path = std::getenv("LW_PROFILE_OUT");
+        std::ofstream json(path ? path : "lw_profile.json");
+        json << std::fixed << std::setprecision(6);
+        json << "{\n  \"seconds\": " << seconds << ",\n  \"ns_per_tick\": " << ns_per_tick
+            << ",\n  \"probes\": [";
+        for (size_t n = 0; n < order.size(); ++n) {
+            const Probe& p = probes[order[n]];
+            const ProbeSlot& s = totals[order[n]];
+            const char* kind = p.kind == ProbeKind::Counter ? "counter" : p.kind == ProbeKind::Timer ? "timer" : "histogram";
+            json << (n ? "," : "") << "\n    {\"name\": \"" << p.name << "\", \"kind\": \"" << kind
+                << "\", \"count\": " << s.count << ", \"sum\": " << s.sum << ", \"max\": " << s.max;
+            if (p.kind == ProbeKind::Timer) {
+                json << ", \"total_ns\": " << std::setprecision(0) << s.sum * ns_per_tick << std::setprecision(6);
+            }
+            if (p.kind != ProbeKind::Counter) {
+                json << ", \"log2_buckets\": {";
+                bool first = true;
+                for (int k = 0; k < 65; ++k) {
+                    if (!s.buckets[k]) continue;
+                    json << (first ? "" : ", ") << "\"" << k << "\": " << s.buckets[k];
+                    first = false;
+                }
+                json << "}";
+            }
+            json << "}";
+        }
+        json << "\n  ]\n}\n";
+    }
+};
+
+// Накопители текущего потока; сливаются в общий реестр при завершении потока
+struct ThreadProfile {
+    std::vector<ProbeSlot> slots;
+
+    ~ThreadProfile() {
+        Registry::instance().merge(slots);
+    }
+
+    ProbeSlot& slot(int id) {
+        if (static_cast<size_t>(id) >= slots.size()) slots.resize(id + 1);
+        return slots[id];
+    }
+};
+
+inline ProbeSlot& slot(int id) {
+    thread_local ThreadProfile profile;
+    return profile.slot(id);
+}
+
+inline void count(int id, std::uint64_t n) {
+    ProbeSlot& s = slot(id);
+    ++s.count;
+    s.sum += n;
+}
+
+class ScopedTimer {
+private:
+    int id;
+    std::uint64_t start;
+
+public:
+    explicit ScopedTimer(int probe_id) : id(probe_id), start(ticks()) {
+    }
+
+    ~ScopedTimer() {
+        slot(id).add(ticks() - start);
+    }
+};
+
+} // namespace profiling
+
+#define LW_PROFILE_CONCAT_(a, b) a##b
+#define LW_PROFILE_CONCAT(a, b) LW_PROFILE_CONCAT_(a, b)
+#define LW_PROFILE_PROBE(name, kind) \
+    static const int LW_PROFILE_CONCAT(lw_probe_, __LINE__) = \
+        ::profiling::Registry::instance().probe(name, ::profiling::ProbeKind::kind)
+
+#define LW_COUNT_ADD(name, n) do { \
+        LW_PROFILE_PROBE(name, Counter); \
+        ::profiling::count(LW_PROFILE_CONCAT(lw_probe_, __LINE__), static_cast<std::uint64_t>(n)); \
+    } while (0)
+#define LW_COUNT(name) LW_COUNT_ADD(name, 1)
+#define LW_HISTOGRAM(name, value) do { \
+        LW_PROFILE_PROBE(name, Histogram); \
+        ::profiling::slot(LW_PROFILE_CONCAT(lw_probe_, __LINE__)).add(static_cast<std::uint64_t>(value)); \
+    } while (0)
+#define LW_TIMER(name) \
+    LW_PROFILE_PROBE(name, Timer); \
+    ::profiling::ScopedTimer LW_PROFILE_CONCAT(lw_timer_, __LINE__)(LW_PROFILE_CONCAT(lw_probe_, __LINE__))
+#define LW_PHASE(name) LW_TIMER(name)
+
+#else
+
+#define LW_COUNT_ADD(name, n) ((void)0)
+#define LW_COUNT(name) ((void)0)
+#define LW_HISTOGRAM(name, value) ((void)sizeof(value))
+#define LW_TIMER(name) ((void)0)
+#define LW_PHASE(name) ((void)0)
+
+#endif
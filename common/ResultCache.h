@@ -0,0 +1,266 @@
+﻿#pragma once
+
+// Постоянный кэш результатов моделирования на диске.
+// Запись адресуется хешем ключа (версия модели, параметры, зерно); в записи
+// хранятся счётчики успехов и испытаний и произвольный текст. Повторный запуск
+// досчитывает только недостающие испытания и добавляет их к уже сохранённым.
+// Запись защищена блокировкой-каталогом и заменяется атомарным переименованием,
+// поэтому несколько процессов на одной машине могут работать с кэшем одновременно.
+// Владелец блокировки отмечается в ней, пока идёт вычисление; отобрать можно
+// только блокировку, владелец которой давно не отмечался (процесс упал).
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+
+// Запись кэша
+struct CacheRecord {
+    long long successes = 0;
+    long long trials = 0;
+    std::string payload;
+};
+
+// Построитель канонического ключа: "scope;name=value;..."
+class CacheKey {
+private:
+    std::ostringstream text;
+
+public:
+    explicit CacheKey(const std::string& scope) {
+        text << std::setprecision(17) << scope;
+    }
+
+    template <class T>
+    CacheKey& add(const char* name, const T& value) {
+        text << ';' << name << '=' << value;
+        return *this;
+    }
+
+    std::string str() const {
+        return text.str();
+    }
+};
+
+class ResultCache {
+private:
+    std::filesystem::path directory;
+
+public:
+    // Каталог по умолчанию - переменная окружения LW_CACHE_DIR или .lw_cache
+    explicit ResultCache(std::filesystem::path dir = defaultDirectory())
+        : directory(std::move(dir)) {
+        std::filesystem::create_directories(directory);
+    }
+
+    static std::filesystem::path defaultDirectory() {
+        const char* env = std::getenv("LW_CACHE_DIR");
+        return (env && *env) ? std::filesystem::path(env) : std::filesystem::path(".lw_cache");
+    }
+
+    // Прочитать запись; false, если её нет или файл принадлежит другому ключу
+    bool load(const std::string& key, CacheRecord& record) const {
+        std::ifstream file(pathFor(key), std::ios::binary);
+        if (!file) {
+            return false;
+        }
+
+        std::string stored_key;
+        size_t payload_size = 0;
+        if (!std::getline(file, stored_key) || stored_key != key) {
+            return false;
+        }
+        if (!(file >> record.successes >> record.trials >> payload_size)) {
+            return false;
+        }
+        file.get(); // перевод строки перед текстом
+
+        record.payload.assign(payload_size, '\0');
+        file.read(record.payload.data(), static_cast<std::streamsize>(payload_size));
+        return static_cast<size_t>(file.gcount()) == payload_size;
+    }
+
+    // Записать через временный файл и атомарное переименование
+    void store(const std::string& key, const CacheRecord& record) const {
+        std::filesystem::path target = pathFor(key);
+        std::ostringstream suffix;
+        suffix << ".tmp." << std::this_thread::get_id() << "."
+            << std::chrono::steady_clock::now().time_since_epoch().count();
+        std::filesystem::path temporary = target;
+        temporary += suffix.str();
+
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            file << key << "\n" << record.successes << " " << record.trials << " "
+                << record.payload.size() << "\n";
+            file.write(record.payload.data(), static_cast<std::streamsize>(record.payload.size()));
+        }
+        std::filesystem::rename(temporary, target);
+    }
+
+    // Довести число испытаний до target_trials. compute(first_trial, count) досчитывает
+    // испытания [first_trial, first_trial + count) и возвращает число успехов среди них;
+    // по first_trial вызывающий выбирает зерно, так что дозапуск не повторяет испытания.
+    template <class Compute>
+    CacheRecord extend(const std::string& key, long long target_trials, Compute compute) {
+        CacheRecord record;
+        if (load(key, record) && record.trials >= target_trials) {
+            return record;
+        }
+
+        Lock lock(*this, key);
+        record = CacheRecord();
+        load(key, record); // запись могла обновить другая копия, пока ждали блокировку
+        if (record.trials < target_trials) {
+            long long count = target_trials - record.trials;
+            record.successes += compute(record.trials, count);
+            record.trials += count;
+            store(key, record);
+        }
+        return record;
+    }
+
+    // Текстовый результат целого сценария: вычисляется один раз для ключа
+    template <class Compute>
+    std::string text(const std::string& key, Compute compute) {
+        CacheRecord record;
+        if (load(key, record)) {
+            return record.payload;
+        }
+
+        Lock lock(*this, key);
+        if (!load(key, record)) {
+            record.payload = compute();
+            record.trials = 1;
+            store(key, record);
+        }
+        return record.payload;
+    }
+
+private:
+    // FNV-1a, 64 бита
+    static std::uint64_t hash(const std::string& key) {
+        std::uint64_t h = 1469598103934665603ULL;
+        for (unsigned char c : key) {
+            h ^= c;
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    std::filesystem::path pathFor(const std::string& key) const {
+        std::ostringstream name;
+        name << std::hex << std::setw(16) << std::setfill('0') << hash(key) << ".rec";
+        return directory / name.str();
+    }
+
+    // Межпроцессная блокировка: создание каталога атомарно на всех платформах.
+    // Внутри каталога - файл owner с меткой владельца; пока блокировка взята, фоновый
+    // поток раз в heartbeat обновляет время изменения этого файла. Блокировка, которую
+    // не обновляли дольше stale_after, считается брошенной упавшим процессом и
+    // отбирается; владелец снимает блокировку, только если метка в ней всё ещё его.
+    class Lock {
+    private:
+        static constexpr std::chrono::minutes stale_after{ 10 };
+        static constexpr std::chrono::seconds heartbeat{ 30 };
+
+        std::filesystem::path path;
+        std::string token;
+        std::mutex mutex;
+        std::condition_variable wake;
+        bool released = false;
+        std::thread beat;
+
+    public:
+        Lock(const ResultCache& cache, const std::string& key) {
+            path = cache.pathFor(key);
+            path += ".lock";
+
+            std::ostringstream label;
+            label << std::random_device{}() << "-" << std::this_thread::get_id() << "-"
+                << std::chrono::steady_clock::now().time_since_epoch().count();
+            token = label.str();
+
+            while (true) {
+                std::error_code error;
+                if (std::filesystem::create_directory(path, error)) {
+                    std::ofstream(ownerFile(), std::ios::trunc) << token;
+                    beat = std::thread([this] { keepAlive(); });
+                    return;
+                }
+
+                if (isStale()) {
+                    // Брошенный каталог сначала переименовывается: из нескольких ждущих
+                    // это удаётся одному, и никто не удалит уже заново взятую блокировку
+                    std::filesystem::path abandoned = path;
+                    abandoned += "." + token;
+                    std::filesystem::rename(path, abandoned, error);
+                    if (!error) {
+                        std::filesystem::remove_all(abandoned, error);
+                    }
+                    continue;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+        }
+
+        ~Lock() {
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                released = true;
+            }
+            wake.notify_all();
+            beat.join();
+
+            std::error_code error;
+            if (owned()) {
+                std::filesystem::remove_all(path, error);
+            }
+        }
+
+        Lock(const Lock&) = delete;
+        Lock& operator=(const Lock&) = delete;
+
+    private:
+        std::filesystem::path ownerFile() const {
+            return path / "owner";
+        }
+
+        bool owned() const {
+            std::ifstream file(ownerFile());
+            std::string stored;
+            return std::getline(file, stored) && stored == token;
+        }
+
+        // Время последней отметки владельца; пока файла owner нет (его только
+        // создают или владелец упал раньше) - время создания каталога
+        bool isStale() const {
+            std::error_code error;
+            auto modified = std::filesystem::last_write_time(ownerFile(), error);
+            if (error) {
+                modified = std::filesystem::last_write_time(path, error);
+            }
+            return !error && std::filesystem::file_time_type::clock::now() - modified > stale_after;
+        }
+
+        void keepAlive() {
+            std::unique_lock<std::mutex> guard(mutex);
+            while (!wake.wait_for(guard, heartbeat, [this] { return released; })) {
+                if (!owned()) {
+                    return; // Блокировку отобрали: не продлеваем чужую
+                }
+                std::error_code error;
+                std::filesystem::last_write_time(ownerFile(), std::filesystem::file_time_type::clock::now(), error);
+            }
+        }
+    };
+};